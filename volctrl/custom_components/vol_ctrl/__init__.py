@@ -1,9 +1,11 @@
 # custom_components/vol_ctrl/__init__.py
 
+import ipaddress
+
 import esphome.codegen as cg
 import esphome.config_validation as cv
 from esphome.components import spi, output
-from esphome.const import CONF_ID, CONF_BACKLIGHT_PIN
+from esphome.const import CONF_ID, CONF_BACKLIGHT_PIN, CONF_NAME
 
 # This is the most critical line for the C++ compiler.
 # It ensures the 'spi' component's headers are included before this one.
@@ -12,13 +14,76 @@ CODEOWNERS = ["@honza"]
 
 # Configuration constants
 CONF_SPI_ID = "spi_id"
+CONF_SUBSCRIBE = "subscribe"
+CONF_SYNC_VOLUME = "sync_volume"
+CONF_UDP_FAST_PATH = "udp_fast_path"
+CONF_NETWORK_TASK = "network_task"
+CONF_MAX_VOLUME = "max_volume"
+CONF_VOLUME_STEP = "volume_step"
+CONF_SPEAKERS = "speakers"
+CONF_SPEAKERS_ID = "speakers_id"
+CONF_IPV6 = "ipv6"
+CONF_ROLE = "role"
+CONF_GROUP = "group"
+CONF_TRIM = "trim"
+
+# Must match network::MAX_DEVICES and network::MAX_DEVICE_NAME
+MAX_SPEAKERS = 16
+MAX_SPEAKER_NAME = 31
 
 vol_ctrl_ns = cg.esphome_ns.namespace('vol_ctrl')
 VolCtrl = vol_ctrl_ns.class_('VolCtrl', cg.Component, spi.SPIDevice)
+network_ns = vol_ctrl_ns.namespace('network')
+SpeakerConfig = network_ns.struct('SpeakerConfig')
+SpeakerRole = network_ns.enum('SpeakerRole', is_class=True)
+
+SPEAKER_ROLES = {
+    "full_range": SpeakerRole.FULL_RANGE,
+    "left": SpeakerRole.LEFT,
+    "right": SpeakerRole.RIGHT,
+    "center": SpeakerRole.CENTER,
+    "subwoofer": SpeakerRole.SUBWOOFER,
+}
+
+
+def validate_ipv6(value):
+    value = cv.string_strict(value)
+    try:
+        return str(ipaddress.IPv6Address(value))
+    except ValueError as err:
+        raise cv.Invalid(f"'{value}' is not a valid IPv6 address") from err
+
+
+def validate_unique_speakers(speakers):
+    seen = set()
+    for speaker in speakers:
+        if speaker[CONF_IPV6] in seen:
+            raise cv.Invalid(f"Speaker address {speaker[CONF_IPV6]} is listed more than once")
+        seen.add(speaker[CONF_IPV6])
+    return speakers
+
+
+SPEAKER_SCHEMA = cv.Schema({
+    cv.Required(CONF_NAME): cv.All(cv.string, cv.Length(max=MAX_SPEAKER_NAME)),
+    cv.Required(CONF_IPV6): validate_ipv6,
+    cv.Optional(CONF_ROLE, default="full_range"): cv.enum(SPEAKER_ROLES, lower=True),
+    cv.Optional(CONF_GROUP, default=0): cv.int_range(min=0, max=255),
+    cv.Optional(CONF_TRIM, default=0.0): cv.float_range(min=-20.0, max=20.0),  # dB
+})
 
 CONFIG_SCHEMA = cv.Schema({
     cv.GenerateID(): cv.declare_id(VolCtrl),
     cv.Optional(CONF_BACKLIGHT_PIN): cv.use_id(output.FloatOutput),
+    cv.Optional(CONF_SUBSCRIBE, default=True): cv.boolean,
+    cv.Optional(CONF_SYNC_VOLUME, default=True): cv.boolean,
+    cv.Optional(CONF_UDP_FAST_PATH, default=False): cv.boolean,
+    cv.Optional(CONF_NETWORK_TASK, default=True): cv.boolean,
+    cv.Optional(CONF_MAX_VOLUME, default=120.0): cv.float_range(min=0.0, max=120.0),
+    cv.Optional(CONF_VOLUME_STEP, default=1.0): cv.float_range(min=0.1, max=10.0),  # Per encoder detent
+    cv.GenerateID(CONF_SPEAKERS_ID): cv.declare_id(SpeakerConfig),
+    cv.Required(CONF_SPEAKERS): cv.All(
+        cv.ensure_list(SPEAKER_SCHEMA), cv.Length(min=1, max=MAX_SPEAKERS), validate_unique_speakers
+    ),
 }).extend(cv.COMPONENT_SCHEMA).extend(spi.spi_device_schema(cs_pin_required=False))
 
 
@@ -31,5 +96,22 @@ async def to_code(config):
         backlight = await cg.get_variable(config[CONF_BACKLIGHT_PIN])
         cg.add(var.set_backlight_pin(backlight))
 
+    cg.add(var.set_subscribe(config[CONF_SUBSCRIBE]))
+    cg.add(var.set_sync_volume(config[CONF_SYNC_VOLUME]))
+    cg.add(var.set_udp_fast_path(config[CONF_UDP_FAST_PATH]))
+    cg.add(var.set_network_task(config[CONF_NETWORK_TASK]))
+    cg.add(var.set_max_volume(config[CONF_MAX_VOLUME]))
+    cg.add(var.set_volume_step(config[CONF_VOLUME_STEP]))
+
+    # The roster becomes a static const table, registration only copies it
+    rows = [
+        cg.ArrayInitializer(
+            speaker[CONF_NAME], speaker[CONF_IPV6], speaker[CONF_ROLE], speaker[CONF_GROUP], speaker[CONF_TRIM]
+        )
+        for speaker in config[CONF_SPEAKERS]
+    ]
+    speakers = cg.static_const_array(config[CONF_SPEAKERS_ID], cg.ArrayInitializer(*rows, multiline=True))
+    cg.add(var.set_speakers(speakers, len(rows)))
+
     cg.add_library("Bodmer/TFT_eSPI", "^2.5.0")
     var.add_include("TFT_eSPI.h")
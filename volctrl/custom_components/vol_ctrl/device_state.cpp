@@ -22,7 +22,6 @@ namespace esphome
 
         bool DeviceState::set_standby_countdown(int new_standby_countdown)
         {
-            bool standby_countdown_change = false;
             if (this->standby_countdown != new_standby_countdown)
             {
                 this->standby_countdown = new_standby_countdown;
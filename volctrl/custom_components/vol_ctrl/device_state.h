@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <map>
 
@@ -17,6 +18,7 @@ namespace esphome
       bool muted = false;
       float volume = -1.0f;  // -1.0f indicates volume not set
       int standby_countdown = -1;
+      bool stale = false;  // Restored from the boot cache, the speaker has not answered yet
 
       bool set_is_up(bool new_is_up);
       float get_requested_volume();
@@ -28,6 +30,35 @@ namespace esphome
       bool set_volume(float new_volume);
       bool set_mute(bool new_mute);    };
 
+// Size of the device table. The speaker roster is limited to 16 (see
+// __init__.py); host builds raise it to benchmark larger fleets.
+#ifndef VOL_CTRL_MAX_DEVICES
+#define VOL_CTRL_MAX_DEVICES 16
+#endif
+
+    static const int MAX_SNAPSHOT_DEVICES = VOL_CTRL_MAX_DEVICES;
+
+    // A speaker's address as configured, plus terminator: the longest textual
+    // IPv6 address (45 characters, IPv4-mapped ones) in the "[address]:port"
+    // form that emulated speakers use
+    static const size_t MAX_ADDRESS_SIZE = 54;
+
+    // Plain copy of every speaker's state for readers that must not touch the
+    // live map (YAML sensors), published through a SeqLock
+    struct DeviceStateSnapshot
+    {
+      struct Device
+      {
+        char ipv6[MAX_ADDRESS_SIZE];
+        bool is_up;
+        bool muted;
+        float volume;
+        int standby_countdown;
+      };
+      uint32_t count;
+      Device devices[MAX_SNAPSHOT_DEVICES];
+    };
+
     // Rotating symbol for UI
     extern const char ROT_SYMBOLS[];
     extern const int ROT_SYMBOLS_LEN;
@@ -0,0 +1,476 @@
+#include "discovery.h"
+#include "ssc_connection.h"
+#include "ssc_json.h"
+#include "platform.h"
+#include <atomic>
+#include <cctype>
+#include <cstring>
+
+namespace esphome {
+namespace vol_ctrl {
+namespace network {
+
+static const char *const TAG = "vol_ctrl.discovery";
+
+// DNS-SD service types of SSC servers (spec 6.5)
+static const char *const SERVICE_TYPES[] = {"_ssc._tcp.local", "_ssc._udp.local"};
+static const char *const MDNS_GROUP = "ff02::fb";
+static const uint16_t MDNS_PORT = 5353;
+static const uint16_t DNS_TYPE_PTR = 12;
+static const uint16_t DNS_TYPE_AAAA = 28;
+static const uint16_t DNS_TYPE_SRV = 33;
+static const uint16_t SSC_PORT = 45;
+static const uint16_t DNS_CLASS_IN = 1;
+
+// Responders answer within a second; the query goes out twice in case the
+// first one is lost
+static const uint32_t BROWSE_MS = 2500;
+static const uint32_t REQUERY_MS = 1000;
+
+// A browsed address, probed over its own short-lived SSC session
+struct Candidate {
+  char ipv6[MAX_ADDRESS_SIZE];  // As the registry keeps it
+  char identity[MAX_DEVICE_NAME + 1];  // read_identity() once it answered, empty before
+  struct sockaddr_in6 addr;
+  SscConnection connection;
+  bool done = false;
+};
+
+// State of the running discovery, owned by the network task. The main loop
+// only flips running to start a run.
+struct Discovery {
+  std::atomic<bool> running{false};
+  int sock = -1;
+  uint32_t started = 0;
+  int queries_sent = 0;
+  Candidate candidates[MAX_DEVICES];
+  uint8_t candidate_count = 0;
+  DeviceMask known = 0;  // Devices that answered, whichever of their addresses they answered with
+  DiscoveryResult result;
+  DiscoveryCallback callback;
+};
+static Discovery discovery;
+
+// Devices added by discovery, persisted after every run that found new ones.
+// Belongs to the main loop.
+struct StoredDevices {
+  uint8_t count;
+  struct {
+    char name[MAX_DEVICE_NAME + 1];
+    char ipv6[MAX_ADDRESS_SIZE];
+  } devices[MAX_DEVICES];
+};
+static StoredDevices stored;
+static ESPPreferenceObject stored_pref;
+
+// Writes name ("_ssc._tcp.local") as DNS labels, returns the length or 0 if it does not fit
+static size_t write_name(uint8_t *out, size_t capacity, const char *name) {
+  size_t len = 0;
+  while (*name != '\0') {
+    const char *dot = strchr(name, '.');
+    size_t label = dot != nullptr ? dot - name : strlen(name);
+    if (label == 0 || label > 63 || len + label + 2 > capacity) {
+      return 0;
+    }
+    out[len++] = static_cast<uint8_t>(label);
+    memcpy(out + len, name, label);
+    len += label;
+    name += dot != nullptr ? label + 1 : label;
+  }
+  out[len++] = 0;
+  return len;
+}
+
+// One PTR question per service type; the ephemeral source port makes it a
+// legacy unicast query (RFC 6762 6.7), answered straight back to our socket
+static size_t build_query(uint8_t *out, size_t capacity) {
+  const size_t question_count = sizeof(SERVICE_TYPES) / sizeof(SERVICE_TYPES[0]);
+  memset(out, 0, 12);
+  out[5] = question_count;  // QDCOUNT
+  size_t len = 12;
+  for (size_t i = 0; i < question_count; i++) {
+    size_t name_len = write_name(out + len, capacity - len - 4, SERVICE_TYPES[i]);
+    if (name_len == 0) {
+      return 0;
+    }
+    len += name_len;
+    out[len++] = DNS_TYPE_PTR >> 8;
+    out[len++] = DNS_TYPE_PTR & 0xFF;
+    out[len++] = DNS_CLASS_IN >> 8;
+    out[len++] = DNS_CLASS_IN & 0xFF;
+  }
+  return len;
+}
+
+// Decodes the possibly compressed name at offset into a lower case, dotted
+// string. Returns the offset just past the name, 0 if it is malformed.
+static size_t read_name(const uint8_t *msg, size_t size, size_t offset, char *name, size_t capacity) {
+  size_t next = 0;  // Where the record continues once a pointer was followed
+  size_t out = 0;
+  int jumps = 0;
+  while (offset < size) {
+    uint8_t len = msg[offset];
+    if (len == 0) {
+      name[out] = '\0';
+      return next != 0 ? next : offset + 1;
+    }
+    if ((len & 0xC0) == 0xC0) {
+      if (offset + 1 >= size || ++jumps > 8) {
+        return 0;
+      }
+      if (next == 0) {
+        next = offset + 2;
+      }
+      offset = ((len & 0x3F) << 8) | msg[offset + 1];
+      continue;
+    }
+    if ((len & 0xC0) != 0 || offset + 1 + len > size || out + len + 2 > capacity) {
+      return 0;
+    }
+    if (out > 0) {
+      name[out++] = '.';
+    }
+    for (uint8_t i = 0; i < len; i++) {
+      name[out++] = static_cast<char>(tolower(msg[offset + 1 + i]));
+    }
+    offset += 1 + len;
+  }
+  return 0;
+}
+
+static bool is_ssc_service(const char *name) {
+  for (const char *service : SERVICE_TYPES) {
+    if (strcmp(name, service) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void send_query() {
+  uint8_t query[64];
+  size_t len = build_query(query, sizeof(query));
+  struct sockaddr_in6 group;
+  memset(&group, 0, sizeof(group));
+  group.sin6_family = AF_INET6;
+  group.sin6_port = htons(MDNS_PORT);
+  inet_pton(AF_INET6, MDNS_GROUP, &group.sin6_addr);
+  // Link-local multicast needs the interface, take the station one
+  group.sin6_scope_id = default_interface_index();
+#ifdef VOL_CTRL_HOST
+  if (host_mdns_port() != 0) {
+    group.sin6_port = htons(host_mdns_port());
+    group.sin6_addr = in6addr_loopback;
+    group.sin6_scope_id = 0;
+  }
+#endif
+  if (sendto(discovery.sock, query, len, 0, (const struct sockaddr *) &group, sizeof(group)) < 0) {
+    ESP_LOGW(TAG, "Failed to send mDNS query: %d (%s)", errno, strerror(errno));
+  }
+  discovery.queries_sent++;
+}
+
+static void count_known(DeviceId id) {
+  if (!(discovery.known & device_bit(id))) {
+    discovery.known |= device_bit(id);
+    discovery.result.found++;
+  }
+}
+
+// True if another answer of this run already came from the same speaker
+static bool seen_identity(uint8_t index) {
+  for (uint8_t i = 0; i < discovery.candidate_count; i++) {
+    if (i != index && strcmp(discovery.candidates[i].identity, discovery.candidates[index].identity) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void probe_candidate(uint8_t index) {
+  Candidate &candidate = discovery.candidates[index];
+  candidate.done = false;
+  candidate.connection.set_address(candidate.ipv6, candidate.addr);
+  bool queued = candidate.connection.submit(IDENTITY_COMMAND, [index](bool success, Slice response) {
+    Candidate &candidate = discovery.candidates[index];
+    candidate.done = true;
+    if (!success || !read_identity(response, candidate.identity, sizeof(candidate.identity))) {
+      ESP_LOGD(TAG, "%s did not answer the identity probe", candidate.ipv6);
+      return;
+    }
+    // A speaker answers with all of its addresses: one that is in the roster
+    // or was found at another address this run is neither counted nor added again
+    DeviceId known = find_device_by_identity(candidate.identity);
+    if (known != INVALID_DEVICE) {
+      ESP_LOGD(TAG, "%s is %s, known at %s", candidate.ipv6, candidate.identity, get_device_address(known));
+      count_known(known);
+      return;
+    }
+    if (seen_identity(index)) {
+      ESP_LOGD(TAG, "%s is %s, found at another address", candidate.ipv6, candidate.identity);
+      return;
+    }
+    SpeakerConfig config = {candidate.identity, candidate.ipv6, SpeakerRole::FULL_RANGE, 0, 0.0f};
+    DeviceId id = register_device(config);
+    if (id == INVALID_DEVICE) {
+      return;
+    }
+    count_known(id);
+    discovery.result.added |= device_bit(id);
+    ESP_LOGI(TAG, "Discovered %s at %s", candidate.identity, candidate.ipv6);
+  });
+  if (!queued) {
+    candidate.done = true;
+  }
+}
+
+// Takes an address from an answer; known devices only count as found. A
+// server on another port than 45 is kept in the "[ipv6]:port" form.
+static void add_candidate(const uint8_t *address, uint16_t port) {
+  // Link-local and multicast addresses would need a scope on every connect
+  if (address[0] == 0xFF || (address[0] == 0xFE && (address[1] & 0xC0) == 0x80)) {
+    return;
+  }
+  char ipv6[MAX_ADDRESS_SIZE];
+  static_assert(MAX_ADDRESS_SIZE >= INET6_ADDRSTRLEN + 8, "Candidate addresses need room for \"[address]:port\"");
+  if (inet_ntop(AF_INET6, address, ipv6, INET6_ADDRSTRLEN) == nullptr) {
+    return;
+  }
+  if (port != SSC_PORT) {
+    char bare[INET6_ADDRSTRLEN];
+    memcpy(bare, ipv6, sizeof(bare));
+    snprintf(ipv6, sizeof(ipv6), "[%s]:%u", bare, port);
+  }
+  for (uint8_t i = 0; i < discovery.candidate_count; i++) {
+    if (strcmp(discovery.candidates[i].ipv6, ipv6) == 0) {
+      return;
+    }
+  }
+  DeviceId known = find_device(ipv6);
+  if (known != INVALID_DEVICE) {
+    count_known(known);
+  }
+  if (discovery.candidate_count == MAX_DEVICES) {
+    ESP_LOGW(TAG, "Too many SSC servers answered, ignoring %s", ipv6);
+    return;
+  }
+  uint8_t index = discovery.candidate_count++;
+  Candidate &candidate = discovery.candidates[index];
+  snprintf(candidate.ipv6, sizeof(candidate.ipv6), "%s", ipv6);
+  candidate.identity[0] = '\0';
+  if (known != INVALID_DEVICE || !parse_ssc_address(ipv6, candidate.addr)) {
+    candidate.done = true;  // Listed only so that a second answer is not counted again
+    return;
+  }
+  ESP_LOGD(TAG, "Probing SSC server candidate %s", ipv6);
+  probe_candidate(index);
+}
+
+// True if the names at offsets a and b of msg are the same
+static bool same_name(const uint8_t *msg, size_t size, size_t a, size_t b) {
+  char name_a[256];
+  char name_b[256];
+  return read_name(msg, size, a, name_a, sizeof(name_a)) != 0 && read_name(msg, size, b, name_b, sizeof(name_b)) != 0 &&
+         strcmp(name_a, name_b) == 0;
+}
+
+// Takes the addresses of a response that advertises an SSC service. Responders
+// put the SRV record and its target's AAAA records into the additional
+// section (RFC 6763 12.1); the SRV port applies to its target's addresses.
+static void parse_response(const uint8_t *msg, size_t size) {
+  if (size < 12) {
+    return;
+  }
+  uint16_t questions = msg[4] << 8 | msg[5];
+  uint16_t records = (msg[6] << 8 | msg[7]) + (msg[8] << 8 | msg[9]) + (msg[10] << 8 | msg[11]);
+  char name[256];
+  size_t offset = 12;
+  for (uint16_t i = 0; i < questions; i++) {
+    offset = read_name(msg, size, offset, name, sizeof(name));
+    if (offset == 0 || offset + 4 > size) {
+      return;
+    }
+    offset += 4;
+  }
+
+  // Names are kept as offsets into msg and only decoded to be compared
+  struct {
+    size_t owner;
+    const uint8_t *address;
+  } addresses[MAX_DEVICES];
+  struct {
+    size_t target;
+    uint16_t port;
+  } services[MAX_DEVICES];
+  size_t address_count = 0;
+  size_t service_count = 0;
+  bool ssc = false;
+  for (uint16_t i = 0; i < records; i++) {
+    size_t owner = offset;
+    offset = read_name(msg, size, offset, name, sizeof(name));
+    if (offset == 0 || offset + 10 > size) {
+      return;
+    }
+    uint16_t type = msg[offset] << 8 | msg[offset + 1];
+    uint16_t length = msg[offset + 8] << 8 | msg[offset + 9];
+    offset += 10;
+    if (offset + length > size) {
+      return;
+    }
+    if (type == DNS_TYPE_PTR && is_ssc_service(name)) {
+      ssc = true;
+    } else if (type == DNS_TYPE_SRV && length > 6 && service_count < MAX_DEVICES) {
+      // Priority, weight, port, target
+      services[service_count].port = msg[offset + 4] << 8 | msg[offset + 5];
+      services[service_count].target = offset + 6;
+      service_count++;
+    } else if (type == DNS_TYPE_AAAA && length == 16 && address_count < MAX_DEVICES) {
+      addresses[address_count].owner = owner;
+      addresses[address_count].address = msg + offset;
+      address_count++;
+    }
+    offset += length;
+  }
+  if (!ssc) {
+    return;
+  }
+  for (size_t i = 0; i < address_count; i++) {
+    uint16_t port = SSC_PORT;
+    for (size_t j = 0; j < service_count; j++) {
+      if (same_name(msg, size, addresses[i].owner, services[j].target)) {
+        port = services[j].port;
+        break;
+      }
+    }
+    add_candidate(addresses[i].address, port);
+  }
+}
+
+static void finish_discovery() {
+  if (discovery.sock >= 0) {
+    ::close(discovery.sock);
+    discovery.sock = -1;
+  }
+  for (uint8_t i = 0; i < discovery.candidate_count; i++) {
+    discovery.candidates[i].connection.close();
+  }
+  ESP_LOGI(TAG, "Discovery found %d SSC servers, %d of them new", discovery.result.found,
+           __builtin_popcountll(discovery.result.added));
+
+  DiscoveryResult result = discovery.result;
+  DiscoveryCallback callback = std::move(discovery.callback);
+  discovery.callback = nullptr;
+  discovery.running = false;
+  run_on_main_loop([result, callback]() {
+    // Persist the new devices next to the ones found before
+    for (DeviceId id = 0; id < device_count(); id++) {
+      if (!(result.added & device_bit(id)) || stored.count == MAX_DEVICES) {
+        continue;
+      }
+      snprintf(stored.devices[stored.count].name, sizeof(stored.devices[0].name), "%s", get_device_name(id));
+      snprintf(stored.devices[stored.count].ipv6, sizeof(stored.devices[0].ipv6), "%s", get_device_address(id));
+      stored.count++;
+    }
+    if (result.added != 0 && !stored_pref.save(&stored)) {
+      ESP_LOGW(TAG, "Failed to persist discovered devices");
+    }
+    if (callback) {
+      callback(result);
+    }
+  });
+}
+
+// Network task side of start_discovery()
+static void begin_discovery(DiscoveryCallback callback) {
+  discovery.callback = std::move(callback);
+  discovery.result = DiscoveryResult();
+  discovery.candidate_count = 0;
+  discovery.known = 0;
+  discovery.queries_sent = 0;
+  discovery.started = millis();
+
+  int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    ESP_LOGE(TAG, "Failed to create mDNS socket: %d (%s)", errno, strerror(errno));
+    finish_discovery();
+    return;
+  }
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    ESP_LOGE(TAG, "Failed to set mDNS socket to non-blocking: %d (%s)", errno, strerror(errno));
+    ::close(sock);
+    finish_discovery();
+    return;
+  }
+  discovery.sock = sock;
+  ESP_LOGI(TAG, "Browsing for SSC servers");
+  send_query();
+}
+
+bool start_discovery(DiscoveryCallback callback) {
+  bool expected = false;
+  if (!discovery.running.compare_exchange_strong(expected, true)) {
+    ESP_LOGW(TAG, "Discovery is already running");
+    return false;
+  }
+  if (!run_in_background([callback]() { begin_discovery(callback); })) {
+    discovery.running = false;
+    return false;
+  }
+  return true;
+}
+
+bool is_discovering() {
+  return discovery.running;
+}
+
+void poll_discovery(uint32_t now) {
+  if (!discovery.running || discovery.sock < 0) {
+    return;
+  }
+  // Worker only, keeps the datagram off the task's stack
+  static uint8_t buffer[1500];
+  ssize_t len;
+  while ((len = recv(discovery.sock, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+    parse_response(buffer, len);
+  }
+
+  bool probing = false;
+  for (uint8_t i = 0; i < discovery.candidate_count; i++) {
+    Candidate &candidate = discovery.candidates[i];
+    if (!candidate.done) {
+      candidate.connection.poll(now);
+      probing |= !candidate.done;
+    }
+  }
+  uint32_t elapsed = now - discovery.started;
+  if (elapsed < BROWSE_MS) {
+    if (discovery.queries_sent == 1 && elapsed >= REQUERY_MS) {
+      send_query();
+    }
+    return;
+  }
+  if (!probing) {
+    finish_discovery();
+  }
+}
+
+void load_discovered_devices() {
+  stored_pref = global_preferences->make_preference<StoredDevices>(fnv1_hash("vol_ctrl_discovered_devices"));
+  if (!stored_pref.load(&stored) || stored.count > MAX_DEVICES) {
+    stored.count = 0;
+    return;
+  }
+  for (uint8_t i = 0; i < stored.count; i++) {
+    // Never trust stored strings to be terminated
+    stored.devices[i].name[MAX_DEVICE_NAME] = '\0';
+    stored.devices[i].ipv6[MAX_ADDRESS_SIZE - 1] = '\0';
+    SpeakerConfig config = {stored.devices[i].name, stored.devices[i].ipv6, SpeakerRole::FULL_RANGE, 0, 0.0f};
+    register_device(config);
+  }
+  ESP_LOGI(TAG, "Restored %d discovered devices", stored.count);
+}
+
+}  // namespace network
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "network.h"
+
+namespace esphome {
+namespace vol_ctrl {
+namespace network {
+
+// Outcome of one discovery run
+struct DiscoveryResult {
+  uint8_t found = 0;     // SSC servers that answered, known ones included
+  DeviceMask added = 0;  // Devices registered by this run
+};
+
+// Called on the main loop once the run is over
+using DiscoveryCallback = std::function<void(const DiscoveryResult &result)>;
+
+// SSC server discovery (spec 6.5). Browses DNS-SD for _ssc._tcp and _ssc._udp
+// with a one-shot mDNS query, probes every new address for
+// /device/identity/product and /device/identity/serial and registers the
+// servers that answer. A server is recognised by its identity, not its
+// address, so one that answers at several addresses is registered once.
+// Everything happens on the network task without blocking. New devices are
+// persisted and load_discovered_devices() brings them back on the next boot.
+// Returns false if a discovery is already running or could not be queued.
+bool start_discovery(DiscoveryCallback callback);
+bool is_discovering();
+
+// Registers the devices found by earlier runs, called from init()
+void load_discovered_devices();
+
+// Advances a running discovery, called on every network service pass
+void poll_discovery(uint32_t now);
+
+}  // namespace network
+}  // namespace vol_ctrl
+}  // namespace esphome
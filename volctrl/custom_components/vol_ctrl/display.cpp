@@ -92,20 +92,17 @@ void update_wiim_status(TFT_eSPI *tft, bool available) {
   tft->drawString("W", region.x, region.y+8); // "W" for WiiM
 }
 
-void update_speaker_dots(TFT_eSPI *tft, const std::map<std::string, DeviceState> &states) {
+void update_speaker_dots(TFT_eSPI *tft, uint32_t up_mask, size_t count) {
   ScreenRegion region = get_speaker_dots_region();
-  int idx = 0;
   int rect_height = region.h;
   int rect_width = region.h / 2 + 2;
   int spacing = 4;
 
-  for (const auto &entry : states) {
-    const DeviceState &state = entry.second;
-    uint16_t color = state.is_up ? TFT_GREEN : TFT_RED;
+  for (size_t idx = 0; idx < count; idx++) {
+    uint16_t color = (up_mask >> idx) & 1 ? TFT_GREEN : TFT_RED;
     int x = region.x + idx * (rect_width + spacing);
     tft->fillRect(x, 0, rect_width, rect_height, color);
     tft->drawRect(x, 0, rect_width, rect_height, TFT_DARKGREY);
-    idx++;
   }
 }
 
@@ -120,7 +117,7 @@ void update_datetime(TFT_eSPI *tft, const std::string &datetime) {
   tft->setTextDatum(MC_DATUM);
 }
 
-void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting) {
+void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting, bool stale) {
   // Clear previous volume display
   ScreenRegion region = get_volume_region();
   // tft->fillRect(region.x, region.y, region.w, region.h, TFT_BLACK);
@@ -142,6 +139,9 @@ void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting) {
   if (user_adjusting) {
     // Use blue for user-initiated changes as per requirements
     tft->setTextColor(TFT_BLUE, TFT_BLACK);
+  } else if (stale) {
+    // Last known level from before the reboot, not confirmed yet
+    tft->setTextColor(TFT_DARKGREY, TFT_BLACK);
   } else {
     tft->setTextColor(TFT_YELLOW, TFT_BLACK);
   }
@@ -151,9 +151,9 @@ void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting) {
   tft->drawString(buf, tft->width()/2, y);
 }
 
-void update_mute_status(TFT_eSPI *tft, bool muted, float volume) {
+void update_mute_status(TFT_eSPI *tft, bool muted, float volume, bool stale) {
   if (!muted) {
-    update_volume_display(tft, volume);
+    update_volume_display(tft, volume, false, stale);
     return; // Avoid drawing mute sign if not muted
   }
   
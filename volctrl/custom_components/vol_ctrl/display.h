@@ -1,7 +1,7 @@
 #pragma once
 
 #include <string>
-#include <map>
+#include <cstdint>
 #include <TFT_eSPI.h>
 #include "device_state.h"
 
@@ -19,11 +19,13 @@ namespace esphome
             // Partial section updates for efficient rendering
             void update_wifi_status(TFT_eSPI *tft, bool connected);
             void update_wiim_status(TFT_eSPI *tft, bool available);
-            void update_speaker_dots(TFT_eSPI *tft, const std::map<std::string, DeviceState> &states);
+            // One dot per speaker, bit n of up_mask set if speaker n is reachable
+            void update_speaker_dots(TFT_eSPI *tft, uint32_t up_mask, size_t count);
             void update_datetime(TFT_eSPI *tft, const std::string &datetime);
             void update_standby_time(TFT_eSPI *tft, int standby_countdown);
-            void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting = false);
-            void update_mute_status(TFT_eSPI *tft, bool muted, float volume = -1.0f);
+            // A stale volume comes from the boot cache and is drawn dimmed
+            void update_volume_display(TFT_eSPI *tft, float volume, bool user_adjusting = false, bool stale = false);
+            void update_mute_status(TFT_eSPI *tft, bool muted, float volume = -1.0f, bool stale = false);
             void update_standby_status(TFT_eSPI *tft, bool standby, bool prev_standby);
             void update_status_message(TFT_eSPI *tft, const std::string &status);
 
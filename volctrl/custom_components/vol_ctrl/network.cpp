@@ -1,19 +1,25 @@
 #include "network.h"
+#include "discovery.h"
+#include "seqlock.h"
+#include "spsc_ring.h"
+#include "ssc_json.h"
+#include "ssc_message.h"
 #include "utils.h"
-#include "wiim_pro.h"
-#include "esphome/core/log.h"
-#include <lwip/sockets.h>
-#include <lwip/inet.h>
-#include <sys/socket.h>
-#include <netinet/in.h>
-#include <arpa/inet.h>
+#include "platform.h"
 #include <cstring>
-#include <map>
-#include <vector>
-#include "esphome/core/hal.h"
-#include <lwip/netif.h>
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#ifdef VOL_CTRL_HOST
+#include <ifaddrs.h>
+#else
 #include <lwip/ip_addr.h>
-#include <esp_http_client.h>
+#endif
+#ifdef USE_ESP32
+#include <esp_attr.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
 
 namespace esphome {
 namespace vol_ctrl {
@@ -21,215 +27,1054 @@ namespace network {
 
 static const char *const TAG = "vol_ctrl.network";
 
-// Device map - name to IPv6 address
-static std::map<std::string, std::string> device_map;
+// What readers outside the main loop see of the device states
+static SeqLock<DeviceStateSnapshot> device_snapshot;
+// Round trip statistics of the sessions, written by the network task
+static SeqLock<LinkStatsSnapshot> link_stats;
 
-// Device status cache
-static std::map<std::string, DeviceState> device_states;
+// Last answered state of every speaker, see restore_device_states(). The RTC
+// copy is zeroed on a cold boot and kept across deep sleep.
+struct BootCache {
+  uint32_t magic;
+  DeviceStateSnapshot states;
+};
+static const uint32_t BOOT_CACHE_MAGIC = 0x564F4C32;  // "VOL2", changes with the layout
+#ifdef USE_ESP32
+RTC_DATA_ATTR static BootCache rtc_boot_cache;
+#endif
+static BootCache boot_cache;
+static ESPPreferenceObject boot_cache_pref;
 
-// Rotating symbol state
-static std::map<std::string, int> device_rot;
+// Time one loop() pass may spend advancing SSC sessions
+static const uint32_t LOOP_BUDGET_US = 2000;
 
-bool send_ssc_command(const std::string &ipv6, const std::string &command, std::string &response) {
-  int sock = -1;
-  bool success = false;
-  uint32_t start_time = millis();
-  
-  ESP_LOGD(TAG, "Attempting to connect to [%s]:45 to send command: %s", ipv6.c_str(), command.c_str());
+// SSC subscription bookkeeping per device (spec 5.1.9 / 8.11)
+struct Subscription {
+  enum class Status { INACTIVE, PENDING, ACTIVE, REJECTED };
+  std::atomic<Status> status{Status::INACTIVE};  // Also read by is_subscribed() on the main loop
+  uint32_t next_attempt = 0;  // millis() of the next subscribe or renewal
+  uint32_t session = 0;       // Connect counter of the session the subscription lives on
+};
+static bool subscriptions_enabled = true;
+static StateListener state_listener;
 
-  // Create socket
-  sock = socket(AF_INET6, SOCK_STREAM, 0);
-  if (sock < 0) {
-    ESP_LOGE(TAG, "Failed to create socket: %d (%s)", errno, strerror(errno));
+// The speaker drops a subscription once its lifetime (30 s, see the "#" entry
+// of SUBSCRIBE_COMMAND) runs out, so it is renewed well before that. Failed
+// attempts are retried at polling pace.
+static const uint32_t SUBSCRIPTION_RENEW_MS = 20000;
+static const uint32_t SUBSCRIPTION_RETRY_MS = 10000;
+static const char *const SUBSCRIBE_PATH = "/osc/state/subscribe";
+static const int SUBSCRIPTION_TERMINATES = 310;  // SSC status that ends a subscription
+static const char *const SUBSCRIBE_COMMAND =
+    "{\"osc\":{\"state\":{\"subscribe\":[{\"#\":{\"lifetime\":30},"
+    "\"audio\":{\"out\":{\"level\":null,\"mute\":null}},"
+    "\"device\":{\"standby\":{\"countdown\":null}}}]}}}";
+
+// Optional SSC features of a device (spec 5.1.15), probed once per session
+struct Features {
+  enum class Timetag { UNKNOWN, PROBING, SUPPORTED, UNSUPPORTED };
+  std::atomic<Timetag> timetag{Timetag::UNKNOWN};
+  uint32_t session = 0;  // Connect counter of the session the probe ran on
+  char identity[MAX_DEVICE_NAME + 1] = "";  // read_identity() of the speaker, empty until it answered
+};
+static bool timetag_sync_enabled = true;
+
+// Margin on top of the slowest speaker's one-way delay before a time-tagged
+// level change is applied, covers jitter of the RTT estimate
+static const uint32_t TIMETAG_GUARD_MS = 15;
+// Values below one year are relative to the moment the speaker receives the
+// message (spec 5.1.12); anything this late is not worth synchronising
+static const uint32_t TIMETAG_MAX_DELAY_MS = 250;
+static const char *const FEATURE_TIMETAG_PATH = "/osc/feature/timetag";
+static const char *const TIMETAG_PROBE_COMMAND = "{\"osc\":{\"feature\":{\"timetag\":null}}}";
+
+// Liveness heartbeat per device (spec 5.1.4). A ping costs one short
+// message on the persistent session and its reply is not parsed, so it runs
+// far more often than the state reads. Any successful transaction proves
+// the speaker is there, so a busy session is not pinged at all.
+struct Heartbeat {
+  bool pending = false;
+  bool reported_up = false;  // Last is_up published from a heartbeat
+  uint8_t misses = 0;        // Failed pings in a row
+  uint32_t next_ping = 0;
+};
+static const uint32_t HEARTBEAT_INTERVAL_MS = 2000;
+static const uint32_t HEARTBEAT_RETRY_MS = 500;  // After a miss, confirm it quickly
+// A single lost ping on a busy Wi-Fi must not take the speaker's dot away
+static const uint8_t HEARTBEAT_MISSES_DOWN = 2;
+static const char *const PING_COMMAND = "{\"osc\":{\"ping\":null}}";
+static const char *const PING_PATH = "/osc/ping";
+
+// UDP fast path state of a device, see service_udp()
+struct LevelDatagram {
+  bool pending = false;  // A newer level waits for the rate limit
+  float volume = 0.0f;
+  uint32_t last_sent = 0;
+};
+
+// One entry of the device table. register_device() fills an entry before it
+// counts it, and entries never move or go away, so name, address and
+// connection can be read from either task. The rest has a single owner.
+struct Speaker {
+  char name[MAX_DEVICE_NAME + 1];
+  char ipv6[MAX_ADDRESS_SIZE];
+  SpeakerConfig config;                       // Name and address point at the arrays above
+  struct sockaddr_in6 addr;                   // [ipv6]:45, parsed once for TCP and UDP
+  SscConnection connection;                   // Network task
+  Subscription subscription;                  // Network task, status also read by is_subscribed()
+  Features features;                          // Network task, timetag also read by supports_timetag()
+  LevelDatagram datagram;                     // Network task
+  LinkState link = LinkState::UP;             // Network task, last breaker state seen by track_links()
+  Heartbeat heartbeat;                        // Network task
+  DeviceState state;                          // Main loop
+};
+static Speaker speakers[MAX_DEVICES];
+static_assert(MAX_ADDRESS_SIZE >= INET6_ADDRSTRLEN + 8, "Speaker addresses need room for \"[address]:port\"");
+static std::atomic<DeviceId> speaker_count{0};
+
+static Speaker *find_speaker(DeviceId id) {
+  return id < speaker_count.load(std::memory_order_acquire) ? &speakers[id] : nullptr;
+}
+
+// Everything above this module deals in the master level; each speaker is
+// sent it with its trim added, and what it reports is converted back
+static float speaker_level(DeviceId id, float volume) {
+  return std::max(0.0f, volume + speakers[id].config.trim_db);
+}
+
+static float master_level(DeviceId id, float level) {
+  return level < 0.0f ? level : std::max(0.0f, level - speakers[id].config.trim_db);
+}
+
+// Network task (start_worker()): all SSC, UDP and WiiM I/O runs on a FreeRTOS
+// task pinned to core 0. The main loop hands it jobs through one SPSC ring and
+// gets completions back through another, so callbacks keep running on the
+// main loop from network::loop(). Without the task everything runs inline.
+using Job = std::function<void()>;
+static SpscRing<Job, 64> worker_jobs;   // Main loop -> network task
+static SpscRing<Job, 128> main_events;  // Network task -> main loop
+static std::atomic<bool> worker_running{false};
+#ifdef USE_ESP32
+static TaskHandle_t worker_handle = nullptr;
+static TaskHandle_t main_handle = nullptr;
+
+static const uint32_t WORKER_STACK_SIZE = 8192;
+static const UBaseType_t WORKER_PRIORITY = 5;
+static const BaseType_t WORKER_CORE = 0;  // Next to the WiFi stack, the UI keeps core 1
+static const uint32_t WORKER_IDLE_MS = 2;  // Longest wait for replies between two passes
+#endif
+
+// True on the main loop task, and everywhere when there is no network task
+static bool on_main_loop() {
+#ifdef USE_ESP32
+  return !worker_running || xTaskGetCurrentTaskHandle() == main_handle;
+#else
+  return true;
+#endif
+}
+
+bool run_in_background(std::function<void()> job) {
+  if (!worker_running || !on_main_loop()) {
+    job();
+    return true;
+  }
+  if (!worker_jobs.push(std::move(job))) {
+    ESP_LOGW(TAG, "Network task queue is full, dropping job");
     return false;
   }
+#ifdef USE_ESP32
+  xTaskNotifyGive(worker_handle);
+#endif
+  return true;
+}
 
-  // Set socket to non-blocking mode for connect timeout control
-  int flags = fcntl(sock, F_GETFL, 0);
-  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
-    ESP_LOGE(TAG, "Failed to set socket to non-blocking: %d (%s)", errno, strerror(errno));
-    close(sock);
+void run_on_main_loop(std::function<void()> event) {
+  if (on_main_loop()) {
+    event();
+    return;
+  }
+  // Completions are never dropped, the network task waits for the main loop instead
+  while (!main_events.push(std::move(event))) {
+#ifdef USE_ESP32
+    vTaskDelay(1);
+#endif
+  }
+}
+
+// Wraps a completion callback so that it runs on the main loop
+template<typename... Args> static std::function<void(Args...)> deliver_on_main(std::function<void(Args...)> callback) {
+  if (!callback || !worker_running) {
+    return callback;
+  }
+  return [callback](Args... args) { run_on_main_loop(std::bind(callback, args...)); };
+}
+
+static void handle_notification(DeviceId id, Slice message);
+
+static bool queue_command(DeviceId id, Slice command, SscCallback callback, Slice path = Slice()) {
+  Speaker *speaker = find_speaker(id);
+  if (speaker == nullptr) {
+    ESP_LOGE(TAG, "No SSC session registered for device %u", id);
     return false;
   }
+  ESP_LOGD(TAG, "Queueing command for [%s]:45: %.*s", speaker->ipv6, (int) command.size(), command.data());
+  return speaker->connection.submit(command, std::move(callback), path);
+}
 
-  // Set socket options for send/receive timeouts
-  struct timeval timeout;
-  timeout.tv_sec = 0;  // Reduce to 100ms timeout for maximum UI responsiveness
-  timeout.tv_usec = 100000;  // 100ms in microseconds
-  if (setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) {
-    ESP_LOGE(TAG, "Failed to set receive timeout: %d (%s)", errno, strerror(errno));
-    close(sock);
+DeviceId register_device(const SpeakerConfig &config) {
+  DeviceId existing = find_device(config.ipv6);
+  if (existing != INVALID_DEVICE) {
+    return existing;
+  }
+  DeviceId id = speaker_count.load(std::memory_order_relaxed);
+  if (id >= MAX_DEVICES) {
+    ESP_LOGE(TAG, "Device table is full, cannot register %s (%s)", config.name, config.ipv6);
+    return INVALID_DEVICE;
+  }
+  Speaker &speaker = speakers[id];
+  if (strlen(config.ipv6) >= sizeof(speaker.ipv6) || !parse_ssc_address(config.ipv6, speaker.addr)) {
+    ESP_LOGE(TAG, "Invalid IPv6 address format: %s", config.ipv6);
+    return INVALID_DEVICE;
+  }
+  snprintf(speaker.name, sizeof(speaker.name), "%s", config.name);
+  snprintf(speaker.ipv6, sizeof(speaker.ipv6), "%s", config.ipv6);
+  speaker.config = config;
+  speaker.config.name = speaker.name;
+  speaker.config.ipv6 = speaker.ipv6;
+  speaker.connection.set_address(speaker.ipv6, speaker.addr);
+  speaker.connection.set_notification_handler([id](Slice message) { handle_notification(id, message); });
+  speaker_count.store(id + 1, std::memory_order_release);
+  return id;
+}
+
+DeviceId device_count() {
+  return speaker_count.load(std::memory_order_acquire);
+}
+
+DeviceMask all_devices() {
+  DeviceId count = device_count();
+  // Shifting by the mask's width is undefined
+  return count == sizeof(DeviceMask) * 8 ? ~static_cast<DeviceMask>(0) : device_bit(count) - 1;
+}
+
+DeviceMask devices_in_group(uint8_t group) {
+  DeviceMask devices = 0;
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    if (speakers[id].config.group == group) {
+      devices |= device_bit(id);
+    }
+  }
+  return devices;
+}
+
+DeviceId find_device(const char *ipv6) {
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    if (strcmp(speakers[id].ipv6, ipv6) == 0) {
+      return id;
+    }
+  }
+  return INVALID_DEVICE;
+}
+
+DeviceId find_device_by_identity(const char *identity) {
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    if (strcmp(speakers[id].features.identity, identity) == 0) {
+      return id;
+    }
+  }
+  return INVALID_DEVICE;
+}
+
+bool read_identity(Slice response, char *identity, size_t size) {
+  SscField fields[] = {{"/device/identity/product", SscField::Type::STRING},
+                       {"/device/identity/serial", SscField::Type::STRING}};
+  if (size == 0 || parse_ssc_fields(response, fields, 2) != 2 || fields[0].string.empty() ||
+      fields[1].string.empty()) {
     return false;
   }
-  
-  if (setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout)) < 0) {
-    ESP_LOGE(TAG, "Failed to set send timeout: %d (%s)", errno, strerror(errno));
-    close(sock);
+  const Slice &product = fields[0].string;
+  const Slice &serial = fields[1].string;
+  snprintf(identity, size, "%.*s-%.*s", (int) product.size(), product.data(), (int) serial.size(), serial.data());
+  return true;
+}
+
+const char *get_device_name(DeviceId id) {
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr ? speaker->name : "";
+}
+
+const char *get_device_address(DeviceId id) {
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr ? speaker->ipv6 : "";
+}
+
+const SpeakerConfig &get_device_config(DeviceId id) {
+  static const SpeakerConfig unknown = {"", "", SpeakerRole::FULL_RANGE, 0, 0.0f};
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr ? speaker->config : unknown;
+}
+
+bool get_connection_health(DeviceId id, ConnectionHealth &health) {
+  Speaker *speaker = find_speaker(id);
+  if (speaker == nullptr) {
+    return false;
+  }
+  health = speaker->connection.get_health();
+  return true;
+}
+
+const DeviceState &get_device_state(DeviceId id) {
+  return edit_device_state(id);
+}
+
+DeviceState &edit_device_state(DeviceId id) {
+  static DeviceState unknown;  // Absorbs writes for IDs that were never handed out
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr ? speaker->state : unknown;
+}
+
+// Merges the speakers that have answered into the boot cache. A speaker that
+// is offline keeps its entry, so the next boot still has its last level.
+// Standby countdown ticks alone do not cause a write.
+static void update_boot_cache(const DeviceStateSnapshot &snapshot) {
+  DeviceStateSnapshot &cache = boot_cache.states;
+  bool changed = false;
+  for (uint32_t i = 0; i < snapshot.count; i++) {
+    const DeviceStateSnapshot::Device &device = snapshot.devices[i];
+    if (!device.is_up || device.volume < 0.0f) {
+      continue;
+    }
+    uint32_t slot = 0;
+    while (slot < cache.count && strcmp(cache.devices[slot].ipv6, device.ipv6) != 0) {
+      slot++;
+    }
+    if (slot == MAX_SNAPSHOT_DEVICES) {
+      continue;
+    }
+    if (slot == cache.count) {
+      cache.count++;
+      changed = true;
+    }
+    DeviceStateSnapshot::Device &cached = cache.devices[slot];
+    changed |= cached.volume != device.volume || cached.muted != device.muted;
+    cached = device;
+  }
+  if (!changed) {
+    return;
+  }
+  boot_cache.magic = BOOT_CACHE_MAGIC;
+#ifdef USE_ESP32
+  rtc_boot_cache = boot_cache;
+#endif
+  // ESPHome only writes this to flash on its next preferences sync
+  boot_cache_pref.save(&boot_cache);
+}
+
+void publish_device_states() {
+  static DeviceStateSnapshot published;
+  DeviceStateSnapshot snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));  // Padding too, for the comparison below
+  snapshot.count = device_count();
+  for (DeviceId id = 0; id < snapshot.count; id++) {
+    const Speaker &speaker = speakers[id];
+    DeviceStateSnapshot::Device &device = snapshot.devices[id];
+    snprintf(device.ipv6, sizeof(device.ipv6), "%s", speaker.ipv6);
+    device.is_up = speaker.state.is_up;
+    device.muted = speaker.state.muted;
+    device.volume = speaker.state.volume;
+    device.standby_countdown = speaker.state.standby_countdown;
+  }
+  if (device_snapshot.version() > 0 && memcmp(&snapshot, &published, sizeof(snapshot)) == 0) {
+    return;
+  }
+  published = snapshot;
+  device_snapshot.store(snapshot);
+  update_boot_cache(snapshot);
+}
+
+bool restore_device_states() {
+  boot_cache_pref = global_preferences->make_preference<BootCache>(fnv1_hash("vol_ctrl_boot_cache"));
+  const char *source = "flash";
+  bool loaded = false;
+#ifdef USE_ESP32
+  if (rtc_boot_cache.magic == BOOT_CACHE_MAGIC) {
+    boot_cache = rtc_boot_cache;
+    source = "RTC memory";
+    loaded = true;
+  }
+#endif
+  if (!loaded) {
+    loaded = boot_cache_pref.load(&boot_cache) && boot_cache.magic == BOOT_CACHE_MAGIC;
+  }
+  if (!loaded || boot_cache.states.count > MAX_SNAPSHOT_DEVICES) {
+    memset(&boot_cache, 0, sizeof(boot_cache));
     return false;
   }
 
-  // Connect to the device
-  struct sockaddr_in6 sa;
-  memset(&sa, 0, sizeof(sa));
-  sa.sin6_family = AF_INET6;
-  sa.sin6_port = htons(45);  // Default SSC port is 45
-  int pton_result = inet_pton(AF_INET6, ipv6.c_str(), &sa.sin6_addr);
-  if (pton_result != 1) {
-    ESP_LOGE(TAG, "Invalid IPv6 address format: %s", ipv6.c_str());
-    close(sock);
+  int restored = 0;
+  for (uint32_t i = 0; i < boot_cache.states.count; i++) {
+    DeviceStateSnapshot::Device &cached = boot_cache.states.devices[i];
+    cached.ipv6[sizeof(cached.ipv6) - 1] = '\0';
+    DeviceId id = find_device(cached.ipv6);
+    if (id == INVALID_DEVICE) {
+      continue;  // No longer configured
+    }
+    DeviceState &state = speakers[id].state;
+    state.volume = cached.volume;
+    state.muted = cached.muted;
+    state.standby_countdown = cached.standby_countdown;
+    state.stale = true;
+    restored++;
+  }
+  ESP_LOGI(TAG, "Restored the state of %d speakers from %s", restored, source);
+  return restored > 0;
+}
+
+DeviceStateSnapshot read_device_states() {
+  return device_snapshot.load();
+}
+
+// SSC addresses of the device state. Level and mute writes are latest-wins on these.
+static constexpr char LEVEL_PATH[] = "/audio/out/level";
+static constexpr char MUTE_PATH[] = "/audio/out/mute";
+static constexpr char COUNTDOWN_PATH[] = "/device/standby/countdown";
+static constexpr char TIMETAG_PATH[] = "/osc/timetag";
+
+// Their JSON skeletons, so that writes only have to print the value
+static constexpr auto LEVEL = ssc_path(LEVEL_PATH);
+static constexpr auto MUTE = ssc_path(MUTE_PATH);
+static constexpr auto TIMETAG = ssc_path(TIMETAG_PATH);
+
+// What a state read returns and a notification may carry, one pass over the message each
+enum StateField { LEVEL_FIELD, MUTE_FIELD, COUNTDOWN_FIELD, STATE_FIELDS };
+
+static bool parse_device_data(Slice response, DeviceVolStdbyData &data) {
+  SscField fields[STATE_FIELDS] = {{LEVEL_PATH, SscField::Type::NUMBER},
+                                   {MUTE_PATH, SscField::Type::BOOLEAN},
+                                   {COUNTDOWN_PATH, SscField::Type::NUMBER}};
+  if (parse_ssc_fields(response, fields, STATE_FIELDS) != STATE_FIELDS) {
     return false;
   }
+  data.volume = fields[LEVEL_FIELD].number;
+  data.mute = fields[MUTE_FIELD].boolean;
+  data.standby_countdown = static_cast<int>(fields[COUNTDOWN_FIELD].number);
+  return true;
+}
 
-  ESP_LOGD(TAG, "Socket created, attempting to connect to [%s]:45...", ipv6.c_str());
-  int connect_result = connect(sock, (struct sockaddr *)&sa, sizeof(sa));
-  
-  if (connect_result < 0) {
-    if (errno == EINPROGRESS) {
-      // Connection in progress, wait with select/poll for up to 100ms
-      fd_set write_fds;
-      FD_ZERO(&write_fds);
-      FD_SET(sock, &write_fds);
-      
-      struct timeval connect_timeout;
-      connect_timeout.tv_sec = 0;
-      connect_timeout.tv_usec = 300000;  // 300ms
-      
-      int select_result = select(sock + 1, nullptr, &write_fds, nullptr, &connect_timeout);
-      if (select_result <= 0) {
-        ESP_LOGE(TAG, "Connection to %s timed out or failed", ipv6.c_str());
-        close(sock);
-        return false;
+// Callback argument indicates whether speaker is up or down, while data struct carries volume, mute and standby-countdown
+static bool read_device_data(DeviceId id, DeviceDataCallback callback) {
+  return queue_command(
+    id,
+    "{\"device\":{\"standby\":{\"countdown\":null}},\"audio\":{\"out\":{\"level\":null,\"mute\":null}}}",
+    [id, callback](bool success, Slice response) {
+      DeviceVolStdbyData data;
+      bool is_up = success && parse_device_data(response, data);
+      if (is_up) {
+        data.volume = master_level(id, data.volume);
+      } else {
+        data = DeviceVolStdbyData();
       }
-      
-      // Check if connection was successful
-      int error = 0;
-      socklen_t len = sizeof(error);
-      if (getsockopt(sock, SOL_SOCKET, SO_ERROR, &error, &len) < 0 || error != 0) {
-        ESP_LOGE(TAG, "Connection to %s failed: %s", ipv6.c_str(), strerror(error));
-        close(sock);
-        return false;
+      callback(is_up, data);
+    });
+}
+
+static void publish_update(DeviceId id, const DeviceStateUpdate &update) {
+  if (state_listener) {
+    run_on_main_loop([id, update]() { state_listener(id, update); });
+  }
+}
+
+// Picks whichever of level, mute and countdown a notification carries
+static bool parse_state_update(Slice message, DeviceStateUpdate &update) {
+  SscField fields[STATE_FIELDS] = {{LEVEL_PATH, SscField::Type::NUMBER},
+                                   {MUTE_PATH, SscField::Type::BOOLEAN},
+                                   {COUNTDOWN_PATH, SscField::Type::NUMBER}};
+  parse_ssc_fields(message, fields, STATE_FIELDS);
+  update.has_volume = fields[LEVEL_FIELD].found;
+  update.volume = fields[LEVEL_FIELD].number;
+  update.has_mute = fields[MUTE_FIELD].found;
+  update.mute = fields[MUTE_FIELD].boolean;
+  update.has_standby_countdown = fields[COUNTDOWN_FIELD].found;
+  update.standby_countdown = static_cast<int>(fields[COUNTDOWN_FIELD].number);
+  return update.has_volume || update.has_mute || update.has_standby_countdown;
+}
+
+static void handle_notification(DeviceId id, Slice message) {
+  Speaker &speaker = speakers[id];
+  ESP_LOGD(TAG, "Notification from %s: %.*s", speaker.ipv6, (int) message.size(), message.data());
+  int status = ssc_error_status(message, SUBSCRIBE_PATH);
+  if (status != 0) {
+    // Lifetime ran out, subscribe again right away
+    if (status == SUBSCRIPTION_TERMINATES && speaker.subscription.status == Subscription::Status::ACTIVE) {
+      ESP_LOGI(TAG, "Subscription on %s terminated by the speaker, renewing", speaker.ipv6);
+      speaker.subscription.status = Subscription::Status::INACTIVE;
+      speaker.subscription.next_attempt = millis();
+    }
+    return;
+  }
+  DeviceStateUpdate update;
+  if (parse_state_update(message, update)) {
+    if (update.has_volume) {
+      update.volume = master_level(id, update.volume);
+    }
+    publish_update(id, update);
+  }
+}
+
+static void subscribe(DeviceId id) {
+  Subscription &subscription = speakers[id].subscription;
+  bool renewal = subscription.status == Subscription::Status::ACTIVE;
+  subscription.status = Subscription::Status::PENDING;
+  bool queued = queue_command(id, SUBSCRIBE_COMMAND, [id, renewal](bool success, Slice response) {
+    Speaker &speaker = speakers[id];
+    Subscription &subscription = speaker.subscription;
+    const char *ipv6 = speaker.ipv6;
+    uint32_t now = millis();
+
+    if (!success) {
+      ESP_LOGW(TAG, "Subscribing to %s failed, polling it until the next attempt", ipv6);
+      subscription.status = Subscription::Status::INACTIVE;
+      subscription.next_attempt = now + SUBSCRIPTION_RETRY_MS;
+      DeviceStateUpdate update;
+      update.is_up = false;
+      publish_update(id, update);
+      return;
+    }
+    if (ssc_error_status(response, SUBSCRIBE_PATH) != 0) {
+      ESP_LOGW(TAG, "Speaker %s rejected the subscription (%.*s), falling back to polling", ipv6,
+               (int) response.size(), response.data());
+      subscription.status = Subscription::Status::REJECTED;
+      return;
+    }
+
+    uint32_t session = speaker.connection.get_health().connects;
+    bool fresh = !renewal || subscription.session != session;
+    subscription.status = Subscription::Status::ACTIVE;
+    subscription.session = session;
+    subscription.next_attempt = now + SUBSCRIPTION_RENEW_MS;
+    if (fresh) {
+      // Notifications only report changes, so read the current values once
+      ESP_LOGI(TAG, "Subscribed to state changes of %s", ipv6);
+      read_device_data(id, [id](bool is_up, const DeviceVolStdbyData &data) {
+        publish_update(id, DeviceStateUpdate(is_up, data));
+      });
+    }
+  });
+  if (!queued) {
+    subscription.status = Subscription::Status::INACTIVE;
+    subscription.next_attempt = millis() + SUBSCRIPTION_RETRY_MS;
+  }
+}
+
+// Subscribes devices that are not subscribed yet, renews subscriptions before
+// they expire and notices when a subscription was lost with its session
+static void maintain_subscriptions(uint32_t now) {
+  if (!subscriptions_enabled) {
+    return;
+  }
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    Speaker &speaker = speakers[id];
+    Subscription &subscription = speaker.subscription;
+    if (subscription.status == Subscription::Status::PENDING || subscription.status == Subscription::Status::REJECTED) {
+      continue;
+    }
+    if (subscription.status == Subscription::Status::ACTIVE) {
+      const ConnectionHealth &health = speaker.connection.get_health();
+      if (!health.connected || health.connects != subscription.session) {
+        ESP_LOGI(TAG, "Session to %s was reset, subscribing again", speaker.ipv6);
+        subscription.status = Subscription::Status::INACTIVE;
+        subscription.next_attempt = now;
       }
-    } else {
-      ESP_LOGE(TAG, "Failed to connect to %s: %d (errno: %d - %s)", 
-               ipv6.c_str(), connect_result, errno, strerror(errno));
-      close(sock);
-      return false;
+    }
+    // A speaker that ignores /osc/xid has its replies matched in order, a
+    // notification would complete whichever request is oldest. Such speakers
+    // are polled; the session's first reply tells which kind it is.
+    SscConnection::XidMode xid_mode = speaker.connection.get_xid_mode();
+    if (xid_mode == SscConnection::XidMode::FIFO) {
+      ESP_LOGW(TAG, "Speaker %s ignores /osc/xid, polling it instead of subscribing", speaker.ipv6);
+      subscription.status = Subscription::Status::REJECTED;
+      continue;
+    }
+    if (xid_mode == SscConnection::XidMode::UNKNOWN) {
+      continue;
+    }
+    if (static_cast<int32_t>(now - subscription.next_attempt) >= 0) {
+      subscribe(id);
     }
   }
-  
-  // Set socket back to blocking mode for send/receive operations
-  if (fcntl(sock, F_SETFL, flags) < 0) {
-    ESP_LOGE(TAG, "Failed to set socket back to blocking: %d (%s)", errno, strerror(errno));
-    close(sock);
-    return false;
+}
+
+// Reports a speaker as offline as soon as its circuit breaker opens, rather
+// than on the next poll or subscription retry, and subscribes again as soon
+// as a probe finds it
+static void track_links(uint32_t now) {
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    Speaker &speaker = speakers[id];
+    LinkState link = speaker.connection.get_health().link;
+    if (link == speaker.link) {
+      continue;
+    }
+    if (link == LinkState::DOWN) {
+      DeviceStateUpdate update;
+      update.is_up = false;
+      publish_update(id, update);
+      speaker.heartbeat.reported_up = false;
+    } else if (speaker.link == LinkState::DOWN) {
+      speaker.heartbeat.next_ping = now;  // Tells the display it is back
+      if (speaker.subscription.status == Subscription::Status::INACTIVE) {
+        speaker.subscription.next_attempt = now;
+      }
+    }
+    speaker.link = link;
   }
-  
-  ESP_LOGD(TAG, "Connected to [%s]:45 in %u ms", ipv6.c_str(), millis() - start_time);
+}
 
-  // Always send command with CRLF line ending as required by the protocol
-  std::string request = command + "\r\n";
-  int sent = 0, total_sent = 0;
-  ESP_LOGD(TAG, "Sending %d bytes: %s", (int)request.length(), request.c_str());
-  
-  while (total_sent < (int)request.length()) {
-    sent = send(sock, request.c_str() + total_sent, request.length() - total_sent, 0);
-    if (sent < 0) {
-      ESP_LOGE(TAG, "Failed to send command: %d (%s)", errno, strerror(errno));
-      close(sock);
-      return false;
+static void publish_link_stats() {
+  static LinkStatsSnapshot published;
+  LinkStatsSnapshot snapshot;
+  memset(&snapshot, 0, sizeof(snapshot));
+  snapshot.count = device_count();
+  for (uint32_t id = 0; id < snapshot.count; id++) {
+    const ConnectionHealth &health = speakers[id].connection.get_health();
+    LinkStats &stats = snapshot.devices[id];
+    stats.smoothed_rtt_ms = health.smoothed_rtt_ms;
+    stats.rtt_variance_ms = health.rtt_variance_ms;
+    stats.timeout_ms = health.timeout_ms != 0 ? health.timeout_ms : SscConnection::REPLY_TIMEOUT_MS;
+    stats.link = health.link;
+  }
+  if (link_stats.version() > 0 && memcmp(&snapshot, &published, sizeof(snapshot)) == 0) {
+    return;
+  }
+  published = snapshot;
+  link_stats.store(snapshot);
+}
+
+LinkStatsSnapshot read_link_stats() {
+  return link_stats.load();
+}
+
+static void ping(DeviceId id, uint32_t now) {
+  Heartbeat &heartbeat = speakers[id].heartbeat;
+  heartbeat.pending = true;
+  // Any reply counts, an SSC error too: the speaker is there to send it
+  bool queued = queue_command(id, PING_COMMAND, [id](bool success, Slice) {
+    Heartbeat &heartbeat = speakers[id].heartbeat;
+    heartbeat.pending = false;
+    heartbeat.misses = success ? 0 : heartbeat.misses + 1;
+    heartbeat.next_ping = millis() + (success ? HEARTBEAT_INTERVAL_MS : HEARTBEAT_RETRY_MS);
+    bool up = heartbeat.misses < HEARTBEAT_MISSES_DOWN;
+    if (up != heartbeat.reported_up) {
+      ESP_LOGI(TAG, "Speaker %s %s", speakers[id].ipv6, up ? "answers pings" : "stopped answering pings");
+      heartbeat.reported_up = up;
+      DeviceStateUpdate update;
+      update.is_up = up;
+      publish_update(id, update);
     }
-    total_sent += sent;
+  }, PING_PATH);
+  if (!queued) {
+    // The breaker refused it, track_links() has already reported the speaker
+    heartbeat.pending = false;
+    heartbeat.next_ping = now + HEARTBEAT_INTERVAL_MS;
   }
-  ESP_LOGD(TAG, "Successfully sent %d bytes in %u ms", total_sent, millis() - start_time);
+}
 
-  // Receive the response
-  char buffer[512];
-  memset(buffer, 0, sizeof(buffer));
-  ESP_LOGD(TAG, "Waiting for response...");
-  int bytes_received = recv(sock, buffer, sizeof(buffer) - 1, 0);
-  if (bytes_received < 0) {
-    ESP_LOGE(TAG, "Failed to receive response: %d (%s)", errno, strerror(errno));
-    close(sock);
-    return false;
+// Pings every speaker whose session was quiet for a heartbeat interval
+static void maintain_heartbeats(uint32_t now) {
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    Speaker &speaker = speakers[id];
+    Heartbeat &heartbeat = speaker.heartbeat;
+    if (heartbeat.pending || speaker.connection.is_down() ||
+        static_cast<int32_t>(now - heartbeat.next_ping) < 0) {
+      continue;
+    }
+    const ConnectionHealth &health = speaker.connection.get_health();
+    if (heartbeat.reported_up && heartbeat.misses == 0 && health.transactions > 0 &&
+        now - health.last_success < HEARTBEAT_INTERVAL_MS) {
+      heartbeat.next_ping = health.last_success + HEARTBEAT_INTERVAL_MS;
+      continue;
+    }
+    ping(id, now);
   }
+}
 
-  response = std::string(buffer, bytes_received);
-  success = true;
-  
-  ESP_LOGD(TAG, "Received %d bytes in %u ms: %s", 
-          bytes_received, millis() - start_time, response.c_str());
-  
-  // Always close the socket
-  close(sock);
-  
-  // Yield control back to RTOS after network operation
-  esphome::yield();
-  
-  return success;
+// Asks every freshly connected speaker whether it supports /osc/timetag, and
+// who it is so that discovery recognises it at its other addresses
+static void probe_features() {
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    Features &feature = speakers[id].features;
+    const ConnectionHealth &health = speakers[id].connection.get_health();
+    if (!health.connected || health.connects == feature.session || feature.timetag == Features::Timetag::PROBING) {
+      continue;
+    }
+    uint32_t session = health.connects;
+    feature.timetag = Features::Timetag::PROBING;
+    bool queued = queue_command(id, TIMETAG_PROBE_COMMAND, [id, session](bool success, Slice response) {
+      Features &feature = speakers[id].features;
+      bool supported = false;
+      if (!success) {
+        feature.timetag = Features::Timetag::UNKNOWN;  // Probe again on the next session
+        return;
+      }
+      if (ssc_error_status(response, FEATURE_TIMETAG_PATH) == 0) {
+        ssc_query(response, FEATURE_TIMETAG_PATH, supported);
+      }
+      feature.timetag = supported ? Features::Timetag::SUPPORTED : Features::Timetag::UNSUPPORTED;
+      feature.session = session;
+      ESP_LOGI(TAG, "Speaker %s %s timed method execution", speakers[id].ipv6,
+               supported ? "supports" : "does not support");
+    });
+    if (!queued) {
+      feature.timetag = Features::Timetag::UNKNOWN;
+      continue;
+    }
+    queue_command(id, IDENTITY_COMMAND, [id](bool success, Slice response) {
+      Features &feature = speakers[id].features;
+      if (success && read_identity(response, feature.identity, sizeof(feature.identity))) {
+        ESP_LOGD(TAG, "Speaker %s is %s", speakers[id].ipv6, feature.identity);
+      }
+    });
+  }
 }
 
-void register_device(const std::string &name, const std::string &ipv6) {
-  device_map[name] = ipv6;
-  device_states[ipv6] = DeviceState();
-  device_rot[ipv6] = 0;
+void set_timetag_sync_enabled(bool enabled) {
+  timetag_sync_enabled = enabled;
 }
 
-const std::map<std::string, DeviceState>& get_device_states() {
-  return device_states;
+bool supports_timetag(DeviceId id) {
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr && speaker->features.timetag == Features::Timetag::SUPPORTED;
 }
 
-// Return value indicates whether speaker is up or down, while data struct carrye volume, mute and standby-countdown
-bool get_device_data(const std::string &ipv6, DeviceVolStdbyData &data) {
-  std::string response;
-  bool success = send_ssc_command(
-    ipv6, 
-    "{\"device\":{\"standby\":{\"countdown\":null}},\"audio\":{\"out\":{\"level\":null,\"mute\":null}}}",
-    response);
-  
-  if (success) {
-    float level = 0.0f;
-    float countdown = 0.0f;
-    bool mute = false;
-    bool ok = true;
-    ok &= utils::extract_json_number(response, "level", level);
-    ok &= utils::extract_json_number(response, "countdown", countdown);
-    ok &= utils::check_json_boolean(response, "mute", mute);
+void set_subscriptions_enabled(bool enabled) {
+  subscriptions_enabled = enabled;
+  if (!enabled) {
+    DeviceId count = device_count();
+    for (DeviceId id = 0; id < count; id++) {
+      speakers[id].subscription.status = Subscription::Status::INACTIVE;
+    }
+  }
+}
+
+void set_state_listener(StateListener listener) {
+  state_listener = std::move(listener);
+}
+
+bool is_subscribed(DeviceId id) {
+  Speaker *speaker = find_speaker(id);
+  return speaker != nullptr && speaker->subscription.status == Subscription::Status::ACTIVE;
+}
+
+
+using SscCommand = SscMessage<SSC_COMMAND_SIZE>;
+
+static void volume_command(SscCommand &command, float level) {
+  command.clear();
+  command.begin().set(LEVEL, level).end();
+}
+
+static void mute_command(SscCommand &command, bool mute) {
+  command.clear();
+  command.begin().set(MUTE, mute).end();
+}
+
+static bool write_device_volume(DeviceId id, float volume, ResultCallback callback) {
+  SscCommand command;
+  volume_command(command, speaker_level(id, volume));
+  return queue_command(id, command, [id, volume, callback](bool success, Slice response) {
+    const char *ipv6 = speakers[id].ipv6;
+    if (success) {
+      ESP_LOGI(TAG, "Successfully set volume to %.1f for device %s, response: %.*s", volume, ipv6,
+               (int) response.size(), response.data());
+    } else {
+      ESP_LOGE(TAG, "Failed to set volume for device %s - network error", ipv6);
+    }
+    if (callback) {
+      callback(success);
+    }
+  }, LEVEL_PATH);
+}
+
+static bool write_device_mute(DeviceId id, bool mute, ResultCallback callback) {
+  SscCommand command;
+  mute_command(command, mute);
+  return queue_command(id, command, [id, mute, callback](bool success, Slice response) {
+    const char *ipv6 = speakers[id].ipv6;
+    if (success) {
+      ESP_LOGI(TAG, "Successfully %s device %s, response: %.*s", mute ? "muted" : "unmuted", ipv6,
+               (int) response.size(), response.data());
+    } else {
+      ESP_LOGE(TAG, "Failed to %s device %s - network error", mute ? "mute" : "unmute", ipv6);
+    }
+    if (callback) {
+      callback(success);
+    }
+  }, MUTE_PATH);
+}
+
+// Shared by the per-speaker callbacks of one group command
+struct GroupDispatch {
+  GroupResult result;
+  size_t pending = 0;
+  uint32_t started = 0;
+  GroupCallback callback;
+  std::string path;  // A speaker that reports an error for it failed
+};
+
+static void finish_group_reply(const std::shared_ptr<GroupDispatch> &dispatch) {
+  if (--dispatch->pending == 0 && dispatch->callback) {
+    dispatch->callback(dispatch->result);
+  }
+}
+
+// Queues the command (per_device[id] instead, if given) on every device in
+// targets and flushes all sessions in one pass
+static bool dispatch_group(DeviceMask targets, Slice command, const SscCommand *per_device, GroupCallback callback,
+                           Slice path) {
+  auto dispatch = std::make_shared<GroupDispatch>();
+  dispatch->callback = std::move(callback);
+  dispatch->started = millis();
+  dispatch->path = path.to_string();
+  GroupResult &result = dispatch->result;
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    if (targets & device_bit(id)) {
+      result.speakers[result.count++].id = id;
+    }
+  }
+  // One extra reference holds the result back until the dispatch pass is over,
+  // a session that fails right away must not report the group half-built
+  dispatch->pending = result.count + 1;
+
+  DeviceMask queued = 0;
+  for (size_t i = 0; i < result.count; i++) {
+    DeviceId id = result.speakers[i].id;
+    bool ok = queue_command(id, per_device != nullptr ? per_device[id].slice() : command,
+                            [dispatch, i](bool success, Slice response) {
+      SpeakerResult &speaker = dispatch->result.speakers[i];
+      speaker.success = success && ssc_error_status(response, dispatch->path) == 0;
+      speaker.reply_ms = millis() - dispatch->started;
+      finish_group_reply(dispatch);
+    }, path);
     if (ok) {
-      data.volume = level;
-      data.standby_countdown = static_cast<int>(countdown);
-      data.mute = mute;
-      return true;
+      queued |= device_bit(id);
+    } else {
+      dispatch->pending--;
     }
   }
-  return false;
+  if (queued == 0) {
+    finish_group_reply(dispatch);  // Reports every speaker as failed
+    return false;
+  }
+
+  // Write to every session now instead of waiting for each one's turn in
+  // loop(). On established sessions this is one non-blocking send() each.
+  int flushed = 0;
+  uint32_t start_us = micros();
+  for (DeviceId id = 0; id < count; id++) {
+    if (queued & device_bit(id)) {
+      speakers[id].connection.poll(millis());
+      flushed++;
+    }
+  }
+  result.dispatch_skew_us = micros() - start_us;
+  ESP_LOGD(TAG, "Dispatched command to %d speakers in %u us", flushed, result.dispatch_skew_us);
+
+  finish_group_reply(dispatch);
+  return true;
 }
 
-bool set_device_volume(const std::string &ipv6, float volume) {
-  std::string command = "{\"audio\":{\"out\":{\"level\":" + std::to_string(volume) + "}}}";
-  std::string response;
-  if (network::send_ssc_command(ipv6, command, response)) {
-    ESP_LOGI(TAG, "Successfully set volume to %.1f for device %s, response: %s", volume, ipv6.c_str(), response.c_str());
-    return true;
-  } else {
-    ESP_LOGE(TAG, "Failed to set volume for device %s - network error", ipv6.c_str());
+static bool queue_group_command(DeviceMask targets, Slice command, GroupCallback callback, Slice path) {
+  return dispatch_group(targets, command, nullptr, std::move(callback), path);
+}
+
+// Builds one time-tagged level command per speaker so that all of them apply
+// the change at the same instant: each one waits out the difference between
+// its own one-way delay and the slowest speaker's. Returns false if any
+// speaker cannot take part, the caller then sends the plain command.
+static bool build_synced_volume_commands(DeviceMask targets, float volume, SscCommand commands[MAX_DEVICES]) {
+  if (!timetag_sync_enabled) {
+    return false;
+  }
+  DeviceId count = device_count();
+  uint32_t max_rtt = 0;
+  uint32_t rtts[MAX_DEVICES] = {};
+  int members = 0;
+  for (DeviceId id = 0; id < count; id++) {
+    if (!(targets & device_bit(id))) {
+      continue;
+    }
+    rtts[id] = speakers[id].connection.get_health().smoothed_rtt_ms;
+    if (!supports_timetag(id) || rtts[id] == 0) {
+      return false;
+    }
+    max_rtt = std::max(max_rtt, rtts[id]);
+    members++;
+  }
+  if (members < 2) {
     return false;
   }
+  if (max_rtt / 2 + TIMETAG_GUARD_MS > TIMETAG_MAX_DELAY_MS) {
+    ESP_LOGW(TAG, "Round trip of %u ms is too slow for synchronised volume", max_rtt);
+    return false;
+  }
+
+  for (DeviceId id = 0; id < count; id++) {
+    if (!(targets & device_bit(id))) {
+      continue;
+    }
+    uint32_t delay_ms = (max_rtt - rtts[id]) / 2 + TIMETAG_GUARD_MS;
+    commands[id].clear();
+    commands[id].begin().set(TIMETAG, delay_ms / 1000.0f, 3).set(LEVEL, speaker_level(id, volume)).end();
+  }
+  return true;
 }
 
-bool set_device_mute(const std::string &ipv6, bool mute) {
-  std::string command = "{\"audio\":{\"out\":{\"mute\":" + std::string(mute ? "true" : "false") + "}}}";
-  std::string response;
-  if (network::send_ssc_command(ipv6, command, response)) {
-    ESP_LOGI(TAG, "Successfully %s device %s, response: %s", mute ? "muted" : "unmuted", ipv6.c_str(), response.c_str());
-    return true;
+static bool write_group_volume(DeviceMask targets, float volume, GroupCallback callback) {
+  // Per speaker either way, each one gets its own trim
+  SscCommand commands[MAX_DEVICES];
+  if (build_synced_volume_commands(targets, volume, commands)) {
+    ESP_LOGD(TAG, "Scheduling volume %.1f with /osc/timetag", volume);
   } else {
-    ESP_LOGE(TAG, "Failed to %s device %s - network error", mute ? "mute" : "unmute", ipv6.c_str());
+    for (DeviceId id = 0; id < device_count(); id++) {
+      if (targets & device_bit(id)) {
+        volume_command(commands[id], speaker_level(id, volume));
+      }
+    }
+  }
+  return dispatch_group(targets, Slice(), commands, [volume, callback](const GroupResult &result) {
+    for (size_t i = 0; i < result.count; i++) {
+      const SpeakerResult &speaker = result.speakers[i];
+      if (speaker.success) {
+        ESP_LOGI(TAG, "Set volume to %.1f for device %s in %u ms", volume, speakers[speaker.id].ipv6,
+                 speaker.reply_ms);
+      } else {
+        ESP_LOGE(TAG, "Failed to set volume for device %s", speakers[speaker.id].ipv6);
+      }
+    }
+    if (callback) {
+      callback(result);
+    }
+  }, LEVEL_PATH);
+}
+
+static bool write_group_mute(DeviceMask targets, bool mute, GroupCallback callback) {
+  SscCommand command;
+  mute_command(command, mute);
+  return queue_group_command(targets, command, [mute, callback](const GroupResult &result) {
+    for (size_t i = 0; i < result.count; i++) {
+      const SpeakerResult &speaker = result.speakers[i];
+      if (speaker.success) {
+        ESP_LOGI(TAG, "Successfully %s device %s in %u ms", mute ? "muted" : "unmuted",
+                 speakers[speaker.id].ipv6, speaker.reply_ms);
+      } else {
+        ESP_LOGE(TAG, "Failed to %s device %s", mute ? "mute" : "unmute", speakers[speaker.id].ipv6);
+      }
+    }
+    if (callback) {
+      callback(result);
+    }
+  }, MUTE_PATH);
+}
+
+// SSC over UDP (spec 6.1): one shared socket for all speakers, used for
+// fire-and-forget level updates while the knob turns. The persistent TCP
+// session still carries the final, confirmed level.
+static int udp_sock = -1;
+static bool udp_fast_path_enabled = false;
+
+// Speakers have no use for more updates than that while the knob turns
+static const uint32_t UDP_MIN_INTERVAL_MS = 40;
+
+static bool open_udp_socket() {
+  if (udp_sock >= 0) {
+    return true;
+  }
+  int sock = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (sock < 0) {
+    ESP_LOGE(TAG, "Failed to create UDP socket: %d (%s)", errno, strerror(errno));
+    return false;
+  }
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    ESP_LOGE(TAG, "Failed to set UDP socket to non-blocking: %d (%s)", errno, strerror(errno));
+    ::close(sock);
     return false;
   }
+  udp_sock = sock;
+  return true;
+}
+
+static void send_datagram(Speaker &speaker, uint32_t now) {
+  LevelDatagram &datagram = speaker.datagram;
+  SscCommand command;
+  volume_command(command, std::max(0.0f, datagram.volume + speaker.config.trim_db));
+  int sent = sendto(udp_sock, command.data(), command.size(), MSG_DONTWAIT, (const struct sockaddr *) &speaker.addr,
+                    sizeof(speaker.addr));
+  if (sent < 0) {
+    // Nothing to retry, the next level or the TCP commit supersedes it
+    ESP_LOGD(TAG, "UDP level update to %s dropped: %d (%s)", speaker.ipv6, errno, strerror(errno));
+  } else {
+    ESP_LOGV(TAG, "UDP level %.1f to %s", datagram.volume, speaker.ipv6);
+  }
+  datagram.pending = false;
+  datagram.last_sent = now;
+}
+
+// Network task side of send_volume_datagram(), which checked id and the socket
+static void queue_volume_datagram(DeviceId id, float volume) {
+  LevelDatagram &datagram = speakers[id].datagram;
+  datagram.volume = volume;
+  datagram.pending = true;
+  uint32_t now = millis();
+  if (now - datagram.last_sent >= UDP_MIN_INTERVAL_MS) {
+    send_datagram(speakers[id], now);
+  }
+}
+
+// Sends levels held back by the rate limit and drains the replies, which
+// carry nothing the TCP commit will not confirm anyway
+static void service_udp(uint32_t now) {
+  if (udp_sock < 0) {
+    return;
+  }
+  DeviceId count = device_count();
+  for (DeviceId id = 0; id < count; id++) {
+    LevelDatagram &datagram = speakers[id].datagram;
+    if (datagram.pending && now - datagram.last_sent >= UDP_MIN_INTERVAL_MS) {
+      send_datagram(speakers[id], now);
+    }
+  }
+  char buffer[256];
+  while (recv(udp_sock, buffer, sizeof(buffer), MSG_DONTWAIT) > 0) {
+  }
+}
+
+void set_udp_fast_path_enabled(bool enabled) {
+  udp_fast_path_enabled = enabled && open_udp_socket();
 }
 
 void log_ipv6_addresses() {
   ESP_LOGI(TAG, "log_ipv6_addresses() called");
+#ifdef VOL_CTRL_HOST
+  struct ifaddrs *addresses = nullptr;
+  if (getifaddrs(&addresses) != 0) {
+    return;
+  }
+  for (struct ifaddrs *entry = addresses; entry != nullptr; entry = entry->ifa_next) {
+    if (entry->ifa_addr == nullptr || entry->ifa_addr->sa_family != AF_INET6) continue;
+    char buf[64];
+    inet_ntop(AF_INET6, &((struct sockaddr_in6 *) entry->ifa_addr)->sin6_addr, buf, sizeof(buf));
+    ESP_LOGI(TAG, "Interface %s IPv6 addr: %s", entry->ifa_name, buf);
+  }
+  freeifaddrs(addresses);
+#else
   struct netif *nif = netif_list;
   while (nif != nullptr) {
     char ifname[8];
@@ -242,20 +1087,170 @@ void log_ipv6_addresses() {
     }
     nif = nif->next;
   }
+#endif
 }
 
-// Initialize the network module with default devices
-void init() {
+// Initialize the network module with the speaker roster from the YAML config
+void init(const SpeakerConfig *roster, size_t count) {
   ESP_LOGI(TAG, "init() called");
   // Log all IPv6 addresses at startup
   log_ipv6_addresses();
   
-  // Here you would normally load devices from persistent storage
-  // For now, hardcoding the known devices from the original code
-  register_device("Left-6473470117", "2a00:1028:8390:75ee:2a36:38ff:fe61:25b9");
-  register_device("Right-6194478038", "2a00:1028:8390:75ee:2a36:38ff:fe61:279e");
+  for (size_t i = 0; i < count; i++) {
+    register_device(roster[i]);
+  }
+  load_discovered_devices();
+  // Sessions connect without allocating, see SscConnection::preallocate_rx_buffers()
+  SscConnection::preallocate_rx_buffers(device_count());
   
-  ESP_LOGI(TAG, "Network module initialized with %d devices", device_map.size());
+  ESP_LOGI(TAG, "Network module initialized with %d devices", (int) device_count());
+}
+
+// Give every SSC session a chance to make progress. Each poll is a handful of
+// non-blocking socket calls; if the pass still runs over budget the remaining
+// sessions are served first on the next pass.
+static void service() {
+  static DeviceId next_index = 0;
+  poll_discovery(millis());
+  DeviceId count = device_count();
+  if (count == 0) {
+    return;
+  }
+  track_links(millis());
+  maintain_heartbeats(millis());
+  maintain_subscriptions(millis());
+  probe_features();
+  service_udp(millis());
+
+  uint32_t start_us = micros();
+  for (DeviceId i = 0; i < count; i++) {
+    if (next_index >= count) {
+      next_index = 0;
+    }
+    speakers[next_index++].connection.poll(millis());
+    if (micros() - start_us > LOOP_BUDGET_US) {
+      break;
+    }
+  }
+  publish_link_stats();
+}
+
+#ifdef USE_ESP32
+static void worker_main(void *) {
+  Job job;
+  while (true) {
+    while (worker_jobs.pop(job)) {
+      job();
+    }
+    service();
+    // Woken early by new jobs, otherwise look for replies every few ms
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(WORKER_IDLE_MS));
+  }
+}
+#endif
+
+bool start_worker() {
+#ifdef USE_ESP32
+  if (worker_running) {
+    return true;
+  }
+  main_handle = xTaskGetCurrentTaskHandle();
+  // Set before the task exists: its first completions must already be queued
+  worker_running = true;
+  if (xTaskCreatePinnedToCore(worker_main, "vol_ctrl_net", WORKER_STACK_SIZE, nullptr, WORKER_PRIORITY, &worker_handle,
+                              WORKER_CORE) != pdPASS) {
+    ESP_LOGE(TAG, "Failed to start network task, running network I/O on the main loop");
+    worker_running = false;
+    return false;
+  }
+  ESP_LOGI(TAG, "Network task started on core %d", (int) WORKER_CORE);
+  return true;
+#else
+  return false;
+#endif
+}
+
+// With the network task this only delivers its completions, bounded so that
+// a burst of replies cannot stall the UI. Otherwise it does the I/O itself.
+void loop() {
+  if (!worker_running) {
+    service();
+    return;
+  }
+  uint32_t start_us = micros();
+  Job event;
+  while (micros() - start_us < LOOP_BUDGET_US && main_events.pop(event)) {
+    event();
+  }
+}
+
+// Public entry points: the I/O runs on the network task (or inline), the
+// callbacks on the main loop
+
+bool send_ssc_command(DeviceId id, const std::string &command, ResponseCallback callback, const std::string &path) {
+  ResponseCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([id, command, done, path]() {
+    // The reply only lives in the session's buffer, this is where it gets copied
+    SscCallback copy_reply;
+    if (done) {
+      copy_reply = [done](bool success, Slice response) { done(success, response.to_string()); };
+    }
+    if (!queue_command(id, command, copy_reply, path) && done) {
+      done(false, "");
+    }
+  });
+}
+
+bool get_device_data(DeviceId id, DeviceDataCallback callback) {
+  DeviceDataCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([id, done]() {
+    if (!read_device_data(id, done) && done) {
+      done(false, DeviceVolStdbyData());
+    }
+  });
+}
+
+bool set_device_volume(DeviceId id, float volume, ResultCallback callback) {
+  ResultCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([id, volume, done]() {
+    if (!write_device_volume(id, volume, done) && done) {
+      done(false);
+    }
+  });
+}
+
+bool set_device_mute(DeviceId id, bool mute, ResultCallback callback) {
+  ResultCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([id, mute, done]() {
+    if (!write_device_mute(id, mute, done) && done) {
+      done(false);
+    }
+  });
+}
+
+bool send_group_command(DeviceMask devices, const std::string &command, GroupCallback callback,
+                        const std::string &path) {
+  GroupCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([devices, command, done, path]() { queue_group_command(devices, command, done, path); });
+}
+
+bool set_group_volume(DeviceMask devices, float volume, GroupCallback callback) {
+  GroupCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([devices, volume, done]() { write_group_volume(devices, volume, done); });
+}
+
+bool set_group_mute(DeviceMask devices, bool mute, GroupCallback callback) {
+  GroupCallback done = deliver_on_main(std::move(callback));
+  return run_in_background([devices, mute, done]() { write_group_mute(devices, mute, done); });
+}
+
+// Everything that could stop the datagram is checked here, so the caller can
+// fall back to TCP; once queued only the network may lose it
+bool send_volume_datagram(DeviceId id, float volume) {
+  if (!udp_fast_path_enabled || find_speaker(id) == nullptr) {
+    return false;
+  }
+  return run_in_background([id, volume]() { queue_volume_datagram(id, volume); });
 }
 
 }  // namespace network
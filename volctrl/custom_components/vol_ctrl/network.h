@@ -1,8 +1,10 @@
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <string>
-#include <vector>
 #include "device_state.h"
+#include "ssc_connection.h"
 
 namespace esphome
 {
@@ -11,6 +13,44 @@ namespace esphome
         namespace network
         {
 
+            // Speakers live in a fixed table and are addressed by their index in it. IDs
+            // are handed out by register_device() in order and stay valid for good.
+            using DeviceId = uint8_t;
+            // Set of speakers, bit n stands for DeviceId n
+#if VOL_CTRL_MAX_DEVICES > 32
+            using DeviceMask = uint64_t;
+#else
+            using DeviceMask = uint32_t;
+#endif
+
+            static const DeviceId MAX_DEVICES = MAX_SNAPSHOT_DEVICES;
+            static const DeviceId INVALID_DEVICE = 0xFF;
+            static_assert(MAX_DEVICES <= sizeof(DeviceMask) * 8, "DeviceMask needs one bit per device");
+
+            inline DeviceMask device_bit(DeviceId id) { return static_cast<DeviceMask>(1) << id; }
+
+            enum class SpeakerRole : uint8_t
+            {
+                FULL_RANGE,
+                LEFT,
+                RIGHT,
+                CENTER,
+                SUBWOOFER,
+            };
+
+            // One entry of the speaker roster. The vol_ctrl codegen emits the roster from the
+            // `speakers:` YAML list as a static const array of these, see __init__.py.
+            struct SpeakerConfig
+            {
+                const char *name;
+                const char *ipv6;
+                SpeakerRole role;
+                uint8_t group;  // Speakers that are controlled together, see devices_in_group()
+                float trim_db;  // Added to every level sent to the speaker, subtracted from levels read back
+            };
+
+            static const size_t MAX_DEVICE_NAME = 31;
+
             struct DeviceVolStdbyData
             {
                 int standby_countdown = 0;
@@ -18,21 +58,182 @@ namespace esphome
                 bool mute = false;
             };
 
-            // Network-related functions
-            bool send_ssc_command(const std::string &ipv6, const std::string &command, std::string &response);
-            bool get_device_data(const std::string &ipv6, DeviceVolStdbyData &data);
-            bool set_device_volume(const std::string &ipv6, float volume);
-            bool set_device_mute(const std::string &ipv6, bool mute);
+            // State change reported by a speaker. Subscription notifications carry only
+            // the values that changed, so every field has its own presence flag.
+            struct DeviceStateUpdate
+            {
+                DeviceStateUpdate() = default;
+                // A failed read carries nothing but is_up, so the cached values stay
+                DeviceStateUpdate(bool is_up, const DeviceVolStdbyData &data)
+                    : is_up(is_up), has_volume(is_up), volume(data.volume), has_mute(is_up), mute(data.mute),
+                      has_standby_countdown(is_up), standby_countdown(data.standby_countdown) {}
+
+                bool is_up = true;
+                bool has_volume = false;
+                float volume = -0.1f;
+                bool has_mute = false;
+                bool mute = false;
+                bool has_standby_countdown = false;
+                int standby_countdown = 0;
+            };
+
+            // Completion callbacks, always invoked from network::loop() on the main loop
+            using DeviceDataCallback = std::function<void(bool is_up, const DeviceVolStdbyData &data)>;
+            using ResultCallback = std::function<void(bool success)>;
+            // A copy of the reply, unlike the SscCallback of the session itself
+            using ResponseCallback = std::function<void(bool success, const std::string &response)>;
+            using StateListener = std::function<void(DeviceId id, const DeviceStateUpdate &update)>;
+
+            // Outcome of one command fanned out to a group of speakers
+            struct SpeakerResult
+            {
+                DeviceId id = INVALID_DEVICE;
+                bool success = false;   // Delivered and not answered with an SSC error
+                uint32_t reply_ms = 0;  // Time from dispatch to the speaker's reply
+            };
+
+            struct GroupResult
+            {
+                SpeakerResult speakers[MAX_DEVICES];  // The first count entries, in DeviceId order
+                size_t count = 0;
+                uint32_t dispatch_skew_us = 0;  // Time between the first and the last speaker's command going out
+
+                size_t succeeded() const
+                {
+                    size_t succeeded = 0;
+                    for (size_t i = 0; i < count; i++)
+                        succeeded += speakers[i].success ? 1 : 0;
+                    return succeeded;
+                }
+            };
+
+            // Called once every speaker of the group has replied or failed
+            using GroupCallback = std::function<void(const GroupResult &result)>;
+
+            // Network-related functions. None of them block: they hand the command to the network
+            // task (or queue it inline) and report the outcome, failures included, through the
+            // callback. They return false only if the network task's queue is full.
+            // Writes that pass the SSC path they set are latest-wins, see SscConnection::submit()
+            bool send_ssc_command(DeviceId id, const std::string &command, ResponseCallback callback,
+                                  const std::string &path = "");
+            bool get_device_data(DeviceId id, DeviceDataCallback callback);
+            bool set_device_volume(DeviceId id, float volume, ResultCallback callback = nullptr);
+            bool set_device_mute(DeviceId id, bool mute, ResultCallback callback = nullptr);
+
+            // Group dispatch: the command is queued on every speaker's session and written
+            // to all of them in the same pass, then the replies are gathered into one
+            // GroupResult, which reports every speaker as failed if none could take it.
+            // set_group_volume() is time-tagged when timetag sync is possible.
+            bool send_group_command(DeviceMask devices, const std::string &command, GroupCallback callback,
+                                    const std::string &path = "");
+            bool set_group_volume(DeviceMask devices, float volume, GroupCallback callback = nullptr);
+            bool set_group_mute(DeviceMask devices, bool mute, GroupCallback callback = nullptr);
+
+            // UDP fast path (spec 6.1): intermediate levels while the knob turns go out as
+            // single datagrams on one shared socket, rate limited and without waiting for a
+            // reply. The final level must still be set over TCP, which confirms it.
+            // Enabling opens the socket, so it must happen before start_worker().
+            void set_udp_fast_path_enabled(bool enabled);
+            // Fire and forget: true once the level is handed to the network task, which
+            // sends it or lets a newer level supersede it. False if the fast path is off,
+            // its socket could not be opened or id is unknown; send the level over TCP then.
+            bool send_volume_datagram(DeviceId id, float volume);
+
+            // A speaker's identity as "product-serial", the name discovery gives it. One
+            // speaker may be reachable at several addresses (global, ULA, temporary), its
+            // identity is the same on all of them. False if the reply lacks either field.
+            static const char *const IDENTITY_COMMAND = "{\"device\":{\"identity\":{\"product\":null,\"serial\":null}}}";
+            bool read_identity(Slice response, char *identity, size_t size);
+
+            // Register device for monitoring. Name and address are copied into the device
+            // table, which allocates nothing. Returns the ID, or INVALID_DEVICE if the address
+            // is invalid or the table is full. Registering an address again returns its ID.
+            // Once start_worker() ran, only the network task registers (discovery.h).
+            DeviceId register_device(const SpeakerConfig &config);
+
+            // The device table: IDs run from 0 to device_count() - 1
+            DeviceId device_count();
+            DeviceMask all_devices();
+            DeviceMask devices_in_group(uint8_t group);
+            DeviceId find_device(const char *ipv6);  // INVALID_DEVICE if unknown
+            // The device that reported this identity (see read_identity()) on its current
+            // or an earlier session, INVALID_DEVICE if none did. Network task only.
+            DeviceId find_device_by_identity(const char *identity);
+            const char *get_device_name(DeviceId id);
+            const char *get_device_address(DeviceId id);
+            // Name and address point into the device table
+            const SpeakerConfig &get_device_config(DeviceId id);
+
+            // Health of the persistent SSC session to a device, false if the device is unknown.
+            // A speaker whose link is DOWN fails commands at once, see SscConnection.
+            // The sessions belong to the network task, read this from a background job.
+            bool get_connection_health(DeviceId id, ConnectionHealth &health);
+
+            // Round trip statistics of every session as diagnostics, in device order.
+            // The network task republishes them whenever they change, reading is lock-free.
+            struct LinkStats
+            {
+                uint32_t smoothed_rtt_ms;  // 0 until measured
+                uint32_t rtt_variance_ms;
+                uint32_t timeout_ms;       // Connect and reply deadline in use
+                LinkState link;
+            };
+            struct LinkStatsSnapshot
+            {
+                uint32_t count;
+                LinkStats devices[MAX_DEVICES];
+            };
+            LinkStatsSnapshot read_link_stats();
+
+            // Subscription mode: each speaker pushes level, mute and standby countdown
+            // changes over its persistent session. Devices that reject the subscription
+            // report is_subscribed() == false and have to be polled.
+            void set_subscriptions_enabled(bool enabled);
+            // Before start_worker(), the network task calls the listener unsynchronised
+            void set_state_listener(StateListener listener);
+            bool is_subscribed(DeviceId id);
+
+            // Synchronised group volume: speakers that support timed method execution
+            // (/osc/feature/timetag, probed on every new session) get group level changes
+            // time-tagged so that all of them apply it at the same instant. Groups with a
+            // speaker that lacks support are sent the plain command.
+            void set_timetag_sync_enabled(bool enabled);
+            bool supports_timetag(DeviceId id);
+
+            // Cached state of a device, id must be below device_count(). The states belong
+            // to the main loop, which is also the only place allowed to change them.
+            const DeviceState &get_device_state(DeviceId id);
+            DeviceState &edit_device_state(DeviceId id);
+
+            // Copies the device states into the snapshot readers see, if they changed.
+            // Call from the main loop after updating the states.
+            void publish_device_states();
+            // Lock-free copy of the last published states, safe from any thread
+            DeviceStateSnapshot read_device_states();
+
+            // Boot cache: publish_device_states() keeps the last level, mute and standby
+            // countdown each speaker reported in RTC memory (survives deep sleep) and in
+            // flash (survives power loss). Call after init() to seed the device states from
+            // it, each marked stale until its speaker answers. False if nothing was restored.
+            bool restore_device_states();
+
+            // Initialize network subsystem and register the speaker roster in order
+            void init(const SpeakerConfig *speakers, size_t count);
+
+            // Move all network I/O to a FreeRTOS task pinned to core 0 so a slow speaker or
+            // WiiM never stalls the UI. Call after init() and the set_*() functions above.
+            // Returns false where there is no such task; everything then runs inline.
+            bool start_worker();
 
-            // Register device for monitoring
-            void register_device(const std::string &name, const std::string &ipv6);
+            // Run blocking work (WiiM HTTP/UPnP) on the network task, inline without one.
+            // Results go back with run_on_main_loop().
+            bool run_in_background(std::function<void()> job);
+            void run_on_main_loop(std::function<void()> event);
 
-            // Get device state map reference
-            const std::map<std::string, DeviceState> &get_device_states();
+            // Deliver completions (or, without the network task, advance all SSC sessions),
+            // call on every main loop pass
+            void loop();
 
-            // Initialize network subsystem
-            void init();
-            
         } // namespace network
     } // namespace vol_ctrl
 } // namespace esphome
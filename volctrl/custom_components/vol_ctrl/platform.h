@@ -0,0 +1,168 @@
+#pragma once
+
+// The few platform services the SSC core (ssc_connection, ssc_json,
+// ssc_message, device_state, utils) and the network module (network,
+// discovery) depend on. On the device they come from ESPHome and lwIP. With
+// VOL_CTRL_HOST defined, as the host build in volctrl/host does, they come
+// from the C library and POSIX sockets instead, so the code can be tested and
+// benchmarked on a Linux machine, e.g. against the SSC emulator.
+
+#ifdef VOL_CTRL_HOST
+
+#include <cerrno>
+#include <chrono>
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace esphome {
+
+// Messages above this level are dropped: 1 errors, 2 warnings, 3 info, 4 debug,
+// 5 verbose. Warnings by default so that benchmarks stay quiet.
+inline int &host_log_level() {
+  static int level = 2;
+  return level;
+}
+
+inline void host_log(int level, char letter, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 4, 5)));
+inline void host_log(int level, char letter, const char *tag, const char *format, ...) {
+  if (level > host_log_level()) {
+    return;
+  }
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "[%c][%s] ", letter, tag);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// Simulations run on a virtual clock: while it is set (not negative),
+// millis() and micros() read it instead of the steady clock and time only
+// moves when the simulation advances it. Single-threaded use only.
+inline int64_t &host_virtual_time_us() {
+  static int64_t time_us = -1;
+  return time_us;
+}
+
+inline uint32_t micros() {
+  if (host_virtual_time_us() >= 0) {
+    return static_cast<uint32_t>(host_virtual_time_us());
+  }
+  auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count());
+}
+
+inline uint32_t millis() {
+  if (host_virtual_time_us() >= 0) {
+    return static_cast<uint32_t>(host_virtual_time_us() / 1000);
+  }
+  auto elapsed = std::chrono::steady_clock::now().time_since_epoch();
+  return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+}
+
+inline uint32_t fnv1_hash(const std::string &str) {
+  uint32_t hash = 2166136261UL;
+  for (char c : str) {
+    hash *= 16777619UL;
+    hash ^= static_cast<uint8_t>(c);
+  }
+  return hash;
+}
+
+// Preferences live in memory for as long as the process runs
+class ESPPreferenceObject {
+ public:
+  ESPPreferenceObject() = default;
+  explicit ESPPreferenceObject(std::vector<uint8_t> *data) : data_(data) {}
+
+  template<typename T> bool save(const T *src) {
+    if (data_ == nullptr) {
+      return false;
+    }
+    const uint8_t *bytes = reinterpret_cast<const uint8_t *>(src);
+    data_->assign(bytes, bytes + sizeof(T));
+    return true;
+  }
+
+  template<typename T> bool load(T *dest) {
+    if (data_ == nullptr || data_->size() != sizeof(T)) {
+      return false;
+    }
+    memcpy(dest, data_->data(), sizeof(T));
+    return true;
+  }
+
+ protected:
+  std::vector<uint8_t> *data_{nullptr};
+};
+
+class ESPPreferences {
+ public:
+  template<typename T> ESPPreferenceObject make_preference(uint32_t type) {
+    return ESPPreferenceObject(&this->store_[type]);
+  }
+  bool sync() { return true; }
+
+ protected:
+  std::map<uint32_t, std::vector<uint8_t>> store_;
+};
+
+inline ESPPreferences *host_preferences() {
+  static ESPPreferences preferences;
+  return &preferences;
+}
+static ESPPreferences *const global_preferences = host_preferences();
+
+// Interface that link-local multicast goes out on, 0 lets the kernel choose
+inline uint32_t default_interface_index() { return 0; }
+
+// Tests point discovery at a stand-in mDNS responder: while set (not 0) the
+// query goes to this port on ::1 instead of the ff02::fb group
+inline uint16_t &host_mdns_port() {
+  static uint16_t port = 0;
+  return port;
+}
+
+}  // namespace esphome
+
+#define ESP_LOGE(tag, ...) ::esphome::host_log(1, 'E', tag, __VA_ARGS__)
+#define ESP_LOGW(tag, ...) ::esphome::host_log(2, 'W', tag, __VA_ARGS__)
+#define ESP_LOGI(tag, ...) ::esphome::host_log(3, 'I', tag, __VA_ARGS__)
+#define ESP_LOGD(tag, ...) ::esphome::host_log(4, 'D', tag, __VA_ARGS__)
+#define ESP_LOGV(tag, ...) ::esphome::host_log(5, 'V', tag, __VA_ARGS__)
+
+#else
+
+#include "esphome/core/defines.h"
+#include "esphome/core/hal.h"
+#include "esphome/core/helpers.h"
+#include "esphome/core/log.h"
+#include "esphome/core/preferences.h"
+#include <lwip/sockets.h>
+#include <lwip/inet.h>
+#include <lwip/netif.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace esphome {
+
+// Interface that link-local multicast goes out on: the station
+inline uint32_t default_interface_index() { return netif_default != nullptr ? netif_get_index(netif_default) : 0; }
+
+}  // namespace esphome
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+namespace esphome {
+namespace vol_ctrl {
+
+// Versioned value with one writer and any number of lock-free readers.
+// store() bumps the sequence to odd, writes and bumps it to even again;
+// load() retries until it copied the value between two equal, even sequence
+// numbers. The value lives in atomic words, so a torn read is discarded
+// instead of being a data race (and ThreadSanitizer agrees).
+template<typename T> class SeqLock {
+  static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+ public:
+  SeqLock() {
+    for (auto &word : data_) {
+      word.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Writer side, only ever called from one thread
+  void store(const T &value) {
+    uint32_t words[WORDS] = {};
+    memcpy(words, &value, sizeof(T));
+    uint32_t seq = sequence_.load(std::memory_order_relaxed);
+    sequence_.store(seq + 1, std::memory_order_relaxed);
+    // Release per word: a reader that sees any new word also sees the odd sequence
+    for (size_t i = 0; i < WORDS; i++) {
+      data_[i].store(words[i], std::memory_order_release);
+    }
+    sequence_.store(seq + 2, std::memory_order_release);
+  }
+
+  // Reader side, safe from any thread
+  T load() const {
+    uint32_t words[WORDS];
+    while (true) {
+      uint32_t before = sequence_.load(std::memory_order_acquire);
+      if (before & 1) {
+        continue;  // Store in progress
+      }
+      // Acquire per word keeps the second sequence check behind the copy
+      for (size_t i = 0; i < WORDS; i++) {
+        words[i] = data_[i].load(std::memory_order_acquire);
+      }
+      if (sequence_.load(std::memory_order_relaxed) == before) {
+        break;
+      }
+    }
+    T value;
+    memcpy(&value, words, sizeof(T));
+    return value;
+  }
+
+  // Number of completed stores
+  uint32_t version() const { return sequence_.load(std::memory_order_acquire) / 2; }
+
+ protected:
+  static const size_t WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  std::atomic<uint32_t> sequence_{0};
+  std::atomic<uint32_t> data_[WORDS];
+};
+
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+namespace esphome {
+namespace vol_ctrl {
+
+// Non-owning view of characters in someone else's buffer, what
+// std::string_view is in C++17. It stays valid only as long as the owner
+// leaves the buffer alone: an SSC reply handed to a callback is gone once the
+// callback returns, so copy it with to_string() to keep it.
+class Slice {
+ public:
+  static const size_t npos = static_cast<size_t>(-1);
+
+  Slice() = default;
+  Slice(const char *data, size_t size) : data_(data), size_(size) {}
+  Slice(const char *str) : data_(str), size_(strlen(str)) {}
+  Slice(const std::string &str) : data_(str.data()), size_(str.size()) {}
+
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  char operator[](size_t i) const { return data_[i]; }
+  const char *begin() const { return data_; }
+  const char *end() const { return data_ + size_; }
+
+  size_t find(char c, size_t pos = 0) const {
+    if (pos >= size_) {
+      return npos;
+    }
+    const void *hit = memchr(data_ + pos, c, size_ - pos);
+    return hit != nullptr ? static_cast<const char *>(hit) - data_ : npos;
+  }
+
+  size_t find(Slice needle, size_t pos = 0) const {
+    if (needle.size_ == 0) {
+      return pos <= size_ ? pos : npos;
+    }
+    while (needle.size_ <= size_ && pos <= size_ - needle.size_) {
+      size_t hit = this->find(needle.data_[0], pos);
+      if (hit == npos || hit > size_ - needle.size_) {
+        return npos;
+      }
+      if (memcmp(data_ + hit, needle.data_, needle.size_) == 0) {
+        return hit;
+      }
+      pos = hit + 1;
+    }
+    return npos;
+  }
+
+  Slice substr(size_t pos, size_t len = npos) const {
+    if (pos > size_) {
+      pos = size_;
+    }
+    if (len > size_ - pos) {
+      len = size_ - pos;
+    }
+    return Slice(data_ + pos, len);
+  }
+
+  bool starts_with(Slice prefix) const {
+    return prefix.size_ <= size_ && memcmp(data_, prefix.data_, prefix.size_) == 0;
+  }
+
+  bool operator==(Slice other) const {
+    return size_ == other.size_ && memcmp(data_, other.data_, size_) == 0;
+  }
+  bool operator!=(Slice other) const { return !(*this == other); }
+
+  std::string to_string() const { return std::string(data_, size_); }
+
+ protected:
+  const char *data_{""};
+  size_t size_{0};
+};
+
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+
+namespace esphome {
+namespace vol_ctrl {
+
+// Bounded lock-free queue for exactly one producer and one consumer thread.
+// Capacity must be a power of two; one slot is kept free to tell full from
+// empty, so N - 1 items fit.
+template<typename T, size_t N> class SpscRing {
+  static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing capacity must be a power of two");
+
+ public:
+  // Producer side, returns false if the ring is full
+  bool push(T &&item) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    size_t next = (head + 1) & (N - 1);
+    if (next == tail_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    slots_[head] = std::move(item);
+    head_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side, returns false if the ring is empty
+  bool pop(T &item) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail == head_.load(std::memory_order_acquire)) {
+      return false;
+    }
+    item = std::move(slots_[tail]);
+    slots_[tail] = T();  // Release whatever the item holds on to right away
+    tail_.store((tail + 1) & (N - 1), std::memory_order_release);
+    return true;
+  }
+
+  bool empty() const { return tail_.load(std::memory_order_acquire) == head_.load(std::memory_order_acquire); }
+
+ protected:
+  T slots_[N];
+  std::atomic<size_t> head_{0};  // Next slot to write, owned by the producer
+  std::atomic<size_t> tail_{0};  // Next slot to read, owned by the consumer
+};
+
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,677 @@
+#include "ssc_connection.h"
+#include "device_state.h"
+#include "ssc_json.h"
+#include "platform.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <utility>
+
+namespace esphome {
+namespace vol_ctrl {
+namespace network {
+
+static const char *const TAG = "vol_ctrl.ssc";
+
+// True once `now` has reached `deadline`, safe across millis() wrap-around
+static inline bool deadline_passed(uint32_t now, uint32_t deadline) { return static_cast<int32_t>(now - deadline) >= 0; }
+
+static inline bool would_block(int err) { return err == EAGAIN || err == EWOULDBLOCK; }
+
+// Receive buffers outlive their sessions: close() puts one back here and the
+// next connect takes it, so reconnects and discovery probes don't allocate
+// 4 KB each time. Sessions run on more than one task in tests, hence atomics.
+static const size_t RX_POOL_SLOTS = 2 * VOL_CTRL_MAX_DEVICES;  // Every speaker and as many probes
+static std::atomic<char *> rx_pool[RX_POOL_SLOTS];
+
+static char *take_rx_buffer() {
+  for (auto &slot : rx_pool) {
+    char *buffer = slot.exchange(nullptr, std::memory_order_acquire);
+    if (buffer != nullptr) {
+      return buffer;
+    }
+  }
+  return new char[SscConnection::RX_BUFFER_SIZE];
+}
+
+static void return_rx_buffer(char *buffer) {
+  for (auto &slot : rx_pool) {
+    char *empty = nullptr;
+    if (slot.compare_exchange_strong(empty, buffer, std::memory_order_release, std::memory_order_relaxed)) {
+      return;
+    }
+  }
+  delete[] buffer;
+}
+
+void SscConnection::preallocate_rx_buffers(size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    return_rx_buffer(new char[RX_BUFFER_SIZE]);
+  }
+}
+
+bool parse_ssc_address(const char *ipv6, struct sockaddr_in6 &addr) {
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_port = htons(45);  // Default SSC port is 45
+  if (ipv6[0] != '[') {
+    return inet_pton(AF_INET6, ipv6, &addr.sin6_addr) == 1;
+  }
+  // [address]:port, for emulated speakers sharing one host address
+  const char *close = strchr(ipv6, ']');
+  if (close == nullptr || close[1] != ':' || close - ipv6 - 1 >= INET6_ADDRSTRLEN) {
+    return false;
+  }
+  char address[INET6_ADDRSTRLEN];
+  memcpy(address, ipv6 + 1, close - ipv6 - 1);
+  address[close - ipv6 - 1] = '\0';
+  char *end = nullptr;
+  unsigned long port = strtoul(close + 2, &end, 10);
+  if (end == close + 2 || *end != '\0' || port == 0 || port > 65535) {
+    return false;
+  }
+  addr.sin6_port = htons(static_cast<uint16_t>(port));
+  return inet_pton(AF_INET6, address, &addr.sin6_addr) == 1;
+}
+
+void tag_with_xid(Slice command, uint32_t xid, std::string &payload) {
+  static const Slice OSC_PREFIX("{\"osc\":{");
+  char tag[32];
+  payload.clear();
+
+  // The message already addresses /osc (e.g. a subscription), add to that container
+  if (command.starts_with(OSC_PREFIX)) {
+    bool empty = command.size() > OSC_PREFIX.size() && command[OSC_PREFIX.size()] == '}';
+    int length = snprintf(tag, sizeof(tag), "\"xid\":%u%s", xid, empty ? "" : ",");
+    payload.reserve(command.size() + length + 2);
+    payload.append(OSC_PREFIX.data(), OSC_PREFIX.size());
+    payload.append(tag, length);
+    payload.append(command.data() + OSC_PREFIX.size(), command.size() - OSC_PREFIX.size());
+    return;
+  }
+
+  size_t body = command.find('{');
+  if (body == Slice::npos) {
+    payload.append(command.data(), command.size());
+    return;
+  }
+  size_t next = body + 1;
+  while (next < command.size() && strchr(" \t\r\n", command[next]) != nullptr) {
+    next++;
+  }
+  bool empty = next < command.size() && command[next] == '}';
+  int length = snprintf(tag, sizeof(tag), "\"osc\":{\"xid\":%u}%s", xid, empty ? "" : ",");
+  payload.reserve(command.size() + length + 2);  // The caller's CR LF included
+  payload.append(command.data(), body + 1);
+  payload.append(tag, length);
+  payload.append(command.data() + body + 1, command.size() - body - 1);
+}
+
+bool extract_xid(Slice message, uint32_t &xid) {
+  size_t pos = message.find("\"xid\":");
+  if (pos == Slice::npos) {
+    return false;
+  }
+  pos += 6;
+  while (pos < message.size() && message[pos] == ' ') {
+    pos++;
+  }
+  // The slice is not terminated, so no strtoul()
+  size_t start = pos;
+  uint32_t value = 0;
+  while (pos < message.size() && message[pos] >= '0' && message[pos] <= '9') {
+    value = value * 10 + (message[pos] - '0');
+    pos++;
+  }
+  if (pos == start) {
+    return false;
+  }
+  xid = value;
+  return true;
+}
+
+void SscConnection::set_address(const char *ipv6, const struct sockaddr_in6 &addr) {
+  this->close();
+  this->ipv6_ = ipv6;
+  this->addr_ = addr;
+  // Whatever the breaker and the RTT estimator learned was about the old
+  // endpoint; a reused session must not stay DOWN for a speaker it never tried
+  this->health_ = ConnectionHealth();
+  this->failed_connects_ = 0;
+  this->journal_.clear();
+}
+
+bool SscConnection::submit(Slice command, SscCallback callback, Slice path) {
+  if (this->health_.link == LinkState::DOWN) {
+    if (!path.empty()) {
+      this->journal_write_(command, path);
+    }
+    ESP_LOGV(TAG, "Speaker %s is down, refusing command: %.*s", this->ipv6_, (int) command.size(), command.data());
+    return false;
+  }
+  if (!path.empty()) {
+    for (auto it = this->queue_.rbegin(); it != this->queue_.rend(); ++it) {
+      if (it->sent != 0 || path != it->path) {
+        continue;
+      }
+      // Not on the wire yet, send the newer value in its place
+      ESP_LOGV(TAG, "Coalescing write to %s on %s", it->path.c_str(), this->ipv6_);
+      tag_with_xid(command, it->xid, it->payload);  // Reuses the replaced payload's memory
+      it->payload += "\r\n";
+      SscCallback superseded = std::move(it->callback);
+      it->callback = [superseded, callback](bool success, Slice response) {
+        if (superseded) {
+          superseded(success, response);
+        }
+        if (callback) {
+          callback(success, response);
+        }
+      };
+      return true;
+    }
+  }
+  if (this->queue_.size() >= MAX_QUEUED) {
+    ESP_LOGW(TAG, "SSC queue for %s is full, dropping command: %.*s", this->ipv6_, (int) command.size(),
+             command.data());
+    return false;
+  }
+  Request request;
+  request.xid = this->next_xid_++;
+  if (this->next_xid_ == 0) {
+    this->next_xid_ = 1;  // 0 is never used so a missing xid cannot match
+  }
+  // Always send command with CRLF line ending as required by the protocol
+  tag_with_xid(command, request.xid, request.payload);
+  request.payload += "\r\n";
+  request.path.assign(path.data(), path.size());
+  request.callback = std::move(callback);
+  this->queue_.push_back(std::move(request));
+  return true;
+}
+
+void SscConnection::poll(uint32_t now) {
+  if (this->dispatching_) {
+    return;  // Called from one of our own callbacks, the outer poll() carries on
+  }
+  switch (this->state_) {
+    case State::DISCONNECTED:
+      if (this->health_.link == LinkState::DOWN) {
+        if (!deadline_passed(now, this->health_.next_probe)) {
+          return;
+        }
+        ESP_LOGV(TAG, "Probing %s", this->ipv6_);
+      } else if (this->queue_.empty()) {
+        return;
+      }
+      if (!this->start_connect_(now)) {
+        return;
+      }
+      if (this->state_ != State::CONNECTED) {
+        return;  // Handshake still in flight
+      }
+      break;
+    case State::CONNECTING:
+      if (!this->check_connect_(now)) {
+        return;
+      }
+      break;
+    case State::CONNECTED:
+      break;
+  }
+
+  if (!this->write_pending_(now)) {
+    return;
+  }
+  if (!this->read_replies_(now)) {
+    return;
+  }
+  this->check_timeouts_(now);
+}
+
+void SscConnection::close() {
+  if (this->sock_ >= 0) {
+    ::close(this->sock_);
+    this->sock_ = -1;
+  }
+  this->state_ = State::DISCONNECTED;
+  // Idle sessions, e.g. finished discovery probes, don't hold a buffer
+  if (this->rx_buffer_ != nullptr) {
+    return_rx_buffer(this->rx_buffer_);
+    this->rx_buffer_ = nullptr;
+  }
+  this->rx_start_ = 0;
+  this->rx_end_ = 0;
+  this->rx_discarding_ = false;
+  this->health_.connected = false;
+}
+
+bool SscConnection::start_connect_(uint32_t now) {
+  int sock = socket(AF_INET6, SOCK_STREAM, 0);
+  if (sock < 0) {
+    ESP_LOGE(TAG, "Failed to create socket: %d (%s)", errno, strerror(errno));
+    this->fail_all_();
+    return false;
+  }
+
+  // The socket stays non-blocking for its whole life
+  int flags = fcntl(sock, F_GETFL, 0);
+  if (flags < 0 || fcntl(sock, F_SETFL, flags | O_NONBLOCK) < 0) {
+    ESP_LOGE(TAG, "Failed to set socket to non-blocking: %d (%s)", errno, strerror(errno));
+    ::close(sock);
+    this->fail_all_();
+    return false;
+  }
+
+  // SSC messages are tiny, don't let Nagle hold them back on a long-lived session
+  int nodelay = 1;
+  setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+  this->sock_ = sock;
+  this->connect_started_ = now;
+  if (connect(sock, (const struct sockaddr *) &this->addr_, sizeof(this->addr_)) == 0) {
+    this->on_connected_(now);
+    return true;
+  }
+  if (errno == EINPROGRESS) {
+    ESP_LOGD(TAG, "Connecting to [%s]:45...", this->ipv6_);
+    this->state_ = State::CONNECTING;
+    this->connect_deadline_ = now + this->connect_timeout_();
+    return true;
+  }
+
+  ESP_LOGE(TAG, "Failed to connect to %s: errno %d (%s)", this->ipv6_, errno, strerror(errno));
+  this->connect_failed_(now);
+  return false;
+}
+
+// Returns true once the pending connect has completed successfully
+bool SscConnection::check_connect_(uint32_t now) {
+  fd_set write_fds;
+  FD_ZERO(&write_fds);
+  FD_SET(this->sock_, &write_fds);
+  struct timeval no_wait = {0, 0};
+
+  int ready = select(this->sock_ + 1, nullptr, &write_fds, nullptr, &no_wait);
+  int error = 0;
+  if (ready == 0) {
+    if (!deadline_passed(now, this->connect_deadline_)) {
+      return false;
+    }
+    ESP_LOGW(TAG, "Connection to %s timed out after %u ms", this->ipv6_, now - this->connect_started_);
+    this->back_off_timeout_();
+  } else {
+    socklen_t len = sizeof(error);
+    if (ready > 0 && getsockopt(this->sock_, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+      this->on_connected_(now);
+      return true;
+    }
+    ESP_LOGW(TAG, "Connection to %s failed: %s", this->ipv6_, strerror(ready < 0 ? errno : error));
+  }
+
+  this->connect_failed_(now);
+  return false;
+}
+
+void SscConnection::on_connected_(uint32_t now) {
+  this->state_ = State::CONNECTED;
+  this->rx_buffer_ = take_rx_buffer();
+  // A firmware update may change xid support, probe again on every session
+  this->xid_mode_ = XidMode::UNKNOWN;
+  this->health_.connected = true;
+  this->health_.connects++;
+  this->sample_rtt_(now - this->connect_started_);  // The handshake is one round trip
+  ESP_LOGI(TAG, "SSC session to [%s]:45 established in %u ms (connect #%u)", this->ipv6_,
+           now - this->connect_started_, this->health_.connects);
+
+  if (this->health_.link == LinkState::DOWN) {
+    ESP_LOGI(TAG, "Speaker %s is reachable again after %u failed connects, replaying %d journaled writes",
+             this->ipv6_, this->failed_connects_, (int) this->journal_.size());
+  }
+  this->health_.link = LinkState::UP;
+  this->health_.backoff_ms = 0;
+  this->failed_connects_ = 0;
+  std::vector<std::pair<std::string, std::string>> journal;
+  journal.swap(this->journal_);
+  for (const auto &write : journal) {
+    this->submit(write.second, nullptr, write.first);
+  }
+}
+
+// Opens the circuit breaker once connects keep failing: from then on only a
+// probe connects, each one backing off twice as long as the last
+void SscConnection::connect_failed_(uint32_t now) {
+  this->close();
+  this->health_.failures++;
+  this->health_.consecutive_failures++;
+  this->failed_connects_++;
+
+  if (this->failed_connects_ < DOWN_AFTER_FAILURES) {
+    this->health_.link = LinkState::SUSPECT;
+  } else {
+    uint32_t backoff = this->health_.backoff_ms * 2;
+    if (backoff < BACKOFF_MIN_MS) {
+      backoff = BACKOFF_MIN_MS;
+    } else if (backoff > BACKOFF_MAX_MS) {
+      backoff = BACKOFF_MAX_MS;
+    }
+    if (this->health_.link != LinkState::DOWN) {
+      ESP_LOGW(TAG, "Speaker %s is down after %u failed connects, failing its commands fast", this->ipv6_,
+               this->failed_connects_);
+    }
+    this->health_.link = LinkState::DOWN;
+    this->health_.backoff_ms = backoff;
+    this->health_.next_probe = now + backoff;
+    ESP_LOGD(TAG, "Next probe of %s in %u ms", this->ipv6_, backoff);
+  }
+  this->fail_all_();
+}
+
+// RFC 6298 estimator with the same 1/8 and 1/4 gains, so one slow reply does
+// not throw it off. Kept scaled like TCP stacks do: in whole milliseconds the
+// truncation would settle SRTT several ms low and RTTVAR as many high.
+void SscConnection::sample_rtt_(uint32_t rtt_ms) {
+  ConnectionHealth &health = this->health_;
+  if (health.timeout_ms == 0) {
+    this->srtt_x8_ = rtt_ms << 3;
+    this->rttvar_x4_ = rtt_ms << 1;  // RTT / 2
+  } else {
+    uint32_t srtt = this->srtt_x8_ >> 3;
+    uint32_t deviation = rtt_ms > srtt ? rtt_ms - srtt : srtt - rtt_ms;
+    this->rttvar_x4_ += deviation - (this->rttvar_x4_ >> 2);
+    this->srtt_x8_ += rtt_ms - srtt;
+  }
+  health.smoothed_rtt_ms = this->srtt_x8_ >> 3;
+  health.rtt_variance_ms = this->rttvar_x4_ >> 2;
+  uint32_t timeout = health.smoothed_rtt_ms + this->rttvar_x4_;  // SRTT + 4 * RTTVAR
+  if (timeout < MIN_TIMEOUT_MS) {
+    timeout = MIN_TIMEOUT_MS;
+  } else if (timeout > MAX_TIMEOUT_MS) {
+    timeout = MAX_TIMEOUT_MS;
+  }
+  health.timeout_ms = timeout;
+}
+
+// A timeout may mean the path got slower, wait longer until a sample says otherwise
+void SscConnection::back_off_timeout_() {
+  uint32_t timeout = this->health_.timeout_ms * 2;
+  if (timeout != 0) {
+    this->health_.timeout_ms = timeout < MAX_TIMEOUT_MS ? timeout : MAX_TIMEOUT_MS;
+  }
+}
+
+// Keeps the latest command per path for when the speaker is back
+void SscConnection::journal_write_(Slice command, Slice path) {
+  for (auto &write : this->journal_) {
+    if (path == write.first) {
+      write.second.assign(command.data(), command.size());
+      return;
+    }
+  }
+  this->journal_.emplace_back(path.to_string(), command.to_string());
+}
+
+// Writes queued requests while the in-flight window has room.
+// Returns false if the session was lost.
+bool SscConnection::write_pending_(uint32_t now) {
+  while (!this->queue_.empty() && this->in_flight_.size() < this->max_in_flight_()) {
+    Request &request = this->queue_.front();
+    if (request.sent == 0 && !request.path.empty() && this->path_in_flight_(request.path)) {
+      break;  // Wait for the previous write to this path, newer values coalesce meanwhile
+    }
+    if (request.sent == 0) {
+      request.started = now;
+      request.deadline = now + this->reply_timeout_();
+    }
+    while (request.sent < request.payload.length()) {
+      int sent = send(this->sock_, request.payload.c_str() + request.sent, request.payload.length() - request.sent,
+                      MSG_DONTWAIT);
+      if (sent > 0) {
+        request.sent += sent;
+        continue;
+      }
+      if (sent < 0 && would_block(errno) && !deadline_passed(now, request.deadline)) {
+        return true;  // Send buffer full, continue on the next pass
+      }
+      ESP_LOGW(TAG, "Failed to send command to %s: %d (%s)", this->ipv6_, errno, strerror(errno));
+      this->connection_lost_();
+      return false;
+    }
+    ESP_LOGD(TAG, "Sent %d bytes to %s: %s", (int) request.sent, this->ipv6_, request.payload.c_str());
+    this->in_flight_.push_back(std::move(request));
+    this->queue_.pop_front();
+  }
+  return true;
+}
+
+bool SscConnection::path_in_flight_(const std::string &path) const {
+  for (const auto &request : this->in_flight_) {
+    if (request.path == path) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Reads whatever the speaker sent and dispatches complete messages, both
+// replies and subscription notifications. Returns false if the session was lost.
+bool SscConnection::read_replies_(uint32_t now) {
+  bool alive = true;
+  while (true) {
+    if (!this->reserve_rx_()) {
+      ESP_LOGW(TAG, "Message from %s is longer than %u bytes, dropping it", this->ipv6_, (unsigned) RX_BUFFER_SIZE);
+      this->rx_start_ = 0;
+      this->rx_end_ = 0;
+      this->rx_discarding_ = true;
+    }
+    int received = recv(this->sock_, this->rx_buffer_ + this->rx_end_, RX_BUFFER_SIZE - this->rx_end_,
+                        MSG_DONTWAIT);
+    if (received > 0) {
+      this->rx_end_ += received;
+      this->dispatch_messages_(now);
+      continue;
+    }
+    if (received == 0) {
+      ESP_LOGI(TAG, "SSC session to %s was closed by the speaker", this->ipv6_);
+      alive = false;
+    } else if (!would_block(errno)) {
+      ESP_LOGW(TAG, "Failed to receive from %s: %d (%s)", this->ipv6_, errno, strerror(errno));
+      alive = false;
+    }
+    break;
+  }
+
+  if (!alive) {
+    this->connection_lost_();
+  }
+  return alive;
+}
+
+void SscConnection::check_timeouts_(uint32_t now) {
+  auto it = this->in_flight_.begin();
+  while (it != this->in_flight_.end()) {
+    if (!deadline_passed(now, it->deadline)) {
+      ++it;
+      continue;
+    }
+    ESP_LOGW(TAG, "No reply from %s to xid %u within %u ms", this->ipv6_, it->xid, now - it->started);
+    this->back_off_timeout_();
+    this->complete_(it, false, "", now);
+    if (this->xid_mode_ != XidMode::TAGGED) {
+      // A late untagged reply would be mistaken for the next one, so start
+      // over on a fresh session
+      this->connection_lost_();
+      return;
+    }
+    // A late tagged reply is recognised and dropped, the session can stay
+    it = this->in_flight_.begin();
+  }
+}
+
+// Makes room behind the received bytes by moving the unfinished message to
+// the front. False if that message alone fills the buffer.
+bool SscConnection::reserve_rx_() {
+  if (this->rx_end_ < RX_BUFFER_SIZE) {
+    return true;
+  }
+  if (this->rx_start_ == 0) {
+    return false;
+  }
+  size_t pending = this->rx_end_ - this->rx_start_;
+  memmove(this->rx_buffer_, this->rx_buffer_ + this->rx_start_, pending);
+  this->rx_start_ = 0;
+  this->rx_end_ = pending;
+  return true;
+}
+
+// Hands every complete message in the buffer to dispatch_message_() as a
+// slice of it. On TCP messages are separated by CR LF or LF LF.
+void SscConnection::dispatch_messages_(uint32_t now) {
+  this->dispatching_ = true;
+  const char *buffer = this->rx_buffer_;
+  while (true) {
+    Slice pending(buffer + this->rx_start_, this->rx_end_ - this->rx_start_);
+    size_t eol = pending.find('\n');
+    if (eol == Slice::npos) {
+      break;
+    }
+    this->rx_start_ += eol + 1;
+    if (this->rx_discarding_) {
+      this->rx_discarding_ = false;  // Tail of the oversized message
+      continue;
+    }
+    size_t len = eol;
+    if (len > 0 && pending[len - 1] == '\r') {
+      len--;
+    }
+    if (len > 0) {  // The second newline of LF LF
+      this->dispatch_message_(pending.substr(0, len), now);
+    }
+  }
+  if (this->rx_start_ == this->rx_end_) {
+    this->rx_start_ = 0;
+    this->rx_end_ = 0;
+  }
+  this->dispatching_ = false;
+}
+
+void SscConnection::dispatch_message_(Slice message, uint32_t now) {
+  uint32_t xid = 0;
+  bool tagged = extract_xid(message, xid);
+
+  if (this->xid_mode_ == XidMode::UNKNOWN && !this->in_flight_.empty()) {
+    this->xid_mode_ = tagged ? XidMode::TAGGED : XidMode::FIFO;
+    ESP_LOGD(TAG, "Speaker %s %s", this->ipv6_,
+             tagged ? "reflects /osc/xid, pipelining requests" : "ignores /osc/xid, sending one request at a time");
+  }
+
+  if (tagged) {
+    for (auto it = this->in_flight_.begin(); it != this->in_flight_.end(); ++it) {
+      if (it->xid == xid) {
+        ESP_LOGD(TAG, "Reply from %s to xid %u in %u ms: %.*s", this->ipv6_, xid, now - it->started,
+                 (int) message.size(), message.data());
+        this->complete_(it, true, message, now);
+        return;
+      }
+    }
+    ESP_LOGD(TAG, "Dropping late reply from %s to xid %u", this->ipv6_, xid);
+    return;
+  }
+
+  // Untagged: the reply to the oldest request if the speaker does not reflect
+  // xids, or an error about a whole request that could not be tagged (e.g. an
+  // unparseable one). Sessions that ignore xids are never subscribed (see
+  // network.cpp), so there nothing else arrives that could be taken for a
+  // reply. A 310 is about the subscription's address and a notification like
+  // any other update.
+  bool error = ssc_error_status(message) != 0;
+  if (!this->in_flight_.empty() && (this->xid_mode_ == XidMode::FIFO || error)) {
+    ESP_LOGD(TAG, "Reply from %s in %u ms: %.*s", this->ipv6_, now - this->in_flight_.front().started,
+             (int) message.size(), message.data());
+    this->complete_(this->in_flight_.begin(), true, message, now);
+    return;
+  }
+  if (this->notification_handler_) {
+    this->notification_handler_(message);
+  } else {
+    ESP_LOGD(TAG, "Discarding unsolicited message from %s: %.*s", this->ipv6_, (int) message.size(), message.data());
+  }
+}
+
+void SscConnection::complete_(std::deque<Request>::iterator it, bool success, Slice response, uint32_t now) {
+  Request request = std::move(*it);
+  this->in_flight_.erase(it);
+
+  if (success) {
+    this->health_.transactions++;
+    this->health_.consecutive_failures = 0;
+    this->health_.last_success = now;
+    this->health_.last_rtt_ms = now - request.started;
+    // Karn's rule: a retried request's reply may answer either attempt
+    if (!request.retried) {
+      this->sample_rtt_(this->health_.last_rtt_ms);
+    }
+  } else {
+    this->health_.failures++;
+    this->health_.consecutive_failures++;
+  }
+
+  // The callback may queue follow-up commands, so it runs after the erase
+  if (request.callback) {
+    request.callback(success, response);
+  }
+}
+
+// A warm session can die between two commands without us noticing, so every
+// request that was already written gets one more try on a fresh connection
+// before it fails. Order is kept: they go back ahead of the unsent ones.
+void SscConnection::connection_lost_() {
+  this->close();
+
+  if (!this->queue_.empty()) {
+    this->queue_.front().sent = 0;  // Partially written, start over
+  }
+
+  std::deque<Request> lost;
+  lost.swap(this->in_flight_);
+  std::deque<Request> failed;
+  while (!lost.empty()) {
+    Request request = std::move(lost.back());
+    lost.pop_back();
+    if (request.retried) {
+      failed.push_front(std::move(request));
+      continue;
+    }
+    ESP_LOGD(TAG, "Retrying xid %u to %s on a new connection", request.xid, this->ipv6_);
+    request.retried = true;
+    request.sent = 0;
+    this->queue_.push_front(std::move(request));
+  }
+
+  for (auto &request : failed) {
+    this->health_.failures++;
+    this->health_.consecutive_failures++;
+    if (request.callback) {
+      request.callback(false, "");
+    }
+  }
+}
+
+// Fails every request, used when the speaker cannot be reached at all
+void SscConnection::fail_all_() {
+  std::deque<Request> failed;
+  failed.swap(this->in_flight_);
+  for (auto &request : this->queue_) {
+    failed.push_back(std::move(request));
+  }
+  this->queue_.clear();
+  for (auto &request : failed) {
+    if (request.callback) {
+      request.callback(false, "");
+    }
+  }
+}
+
+}  // namespace network
+}  // namespace vol_ctrl
+}  // namespace esphome
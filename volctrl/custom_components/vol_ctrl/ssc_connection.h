@@ -0,0 +1,210 @@
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+#include <netinet/in.h>
+#include "slice.h"
+
+namespace esphome {
+namespace vol_ctrl {
+namespace network {
+
+// Whether a speaker is worth connecting to, see SscConnection
+enum class LinkState : uint8_t {
+  UP,       // Connected, or the last connect succeeded
+  SUSPECT,  // The last connect failed, the next request tries again
+  DOWN,     // Connects keep failing: requests fail fast until a probe gets through
+};
+
+// Health counters of one persistent SSC session
+struct ConnectionHealth {
+  LinkState link = LinkState::UP;
+  bool connected = false;
+  uint32_t connects = 0;              // Successful TCP connects, including reconnects
+  uint32_t failures = 0;              // Failed connects and failed transactions
+  uint32_t consecutive_failures = 0;  // Reset by every successful transaction
+  uint32_t transactions = 0;          // Successful request/response round trips
+  uint32_t last_success = 0;          // millis() of the last successful transaction
+  uint32_t last_rtt_ms = 0;           // Round trip time of the last successful transaction
+  uint32_t smoothed_rtt_ms = 0;       // Moving average of the round trip time, 0 until measured
+  uint32_t rtt_variance_ms = 0;       // Moving mean deviation of the round trip time
+  uint32_t timeout_ms = 0;            // Connect and reply deadline learned from the above, 0 until measured
+  uint32_t backoff_ms = 0;            // Current probe interval while DOWN
+  uint32_t next_probe = 0;            // millis() of the next probe connect while DOWN
+};
+
+// Called from poll() once a request completes; response is empty on failure.
+// The response points into the session's receive buffer and is only valid
+// during the call.
+using SscCallback = std::function<void(bool success, Slice response)>;
+
+// Called from poll() for messages the speaker sends on its own (subscriptions),
+// with the same lifetime rule
+using SscNotificationHandler = std::function<void(Slice message)>;
+
+// Long-lived SSC session to a single speaker (TCP port 45).
+// Everything is non-blocking: submit() only queues the message and poll(),
+// called from the main loop, connects, writes queued messages and matches
+// replies as they arrive.
+//
+// Every message is tagged with an /osc/xid transaction ID, which the speaker
+// reflects in its reply (spec 5.1.3). That lets several requests be in flight
+// on the same session at once. A speaker that does not reflect the ID is
+// detected on the first reply of each session and served one request at a
+// time instead.
+//
+// Writes that name the SSC path they set are latest-wins: a newer write to
+// the same path replaces one that is still queued, and at most one write per
+// path is in flight. A burst of level changes therefore costs two writes.
+//
+// A speaker that is switched off must not cost every command a connect
+// timeout. After DOWN_AFTER_FAILURES failed connects in a row the session
+// goes DOWN: submit() then fails at once and only a bare probe connect is
+// made, after a backoff that doubles from BACKOFF_MIN_MS to BACKOFF_MAX_MS.
+// Latest-wins writes refused while DOWN are journaled and sent once a probe
+// gets through, so the speaker comes back at the level the user last chose.
+//
+// Connect and reply deadlines adapt to the speaker like TCP's retransmission
+// timer (RFC 6298): every connect handshake and every reply that was not
+// retried is a round trip sample, the deadline is the smoothed RTT plus four
+// times its mean deviation, clamped to MIN_TIMEOUT_MS..MAX_TIMEOUT_MS, and it
+// doubles on every timeout until the next sample. CONNECT_TIMEOUT_MS and
+// REPLY_TIMEOUT_MS only apply until the first sample.
+//
+// Replies are framed in a fixed RX_BUFFER_SIZE buffer the session takes from
+// a shared pool while it is open: recv() writes straight into it, each
+// complete message is handed out as a Slice of it, and consumed bytes are
+// reclaimed by moving the unfinished tail to the front. A message that does
+// not fit is dropped.
+class SscConnection {
+ public:
+  SscConnection() = default;
+  ~SscConnection() { close(); }
+
+  SscConnection(const SscConnection &) = delete;
+  SscConnection &operator=(const SscConnection &) = delete;
+
+  // Point the session at a speaker's SSC endpoint (see parse_ssc_address()),
+  // closing any previous one and starting over with fresh health. ipv6 is
+  // only kept for logging and must outlive the session.
+  void set_address(const char *ipv6, const struct sockaddr_in6 &addr);
+
+  // Queue one SSC message, returns false if the queue is full or the speaker
+  // is DOWN (a write with a path is then journaled). With a path
+  // (e.g. "/audio/out/level") the message supersedes a queued write to the same
+  // path; the superseded callback then runs with the replacement's result.
+  bool submit(Slice command, SscCallback callback, Slice path = Slice());
+
+  // Advance the state machine without blocking
+  void poll(uint32_t now);
+
+  // Receives messages that are not a reply to one of our requests
+  void set_notification_handler(SscNotificationHandler handler) { notification_handler_ = std::move(handler); }
+
+  void close();
+
+  // Fills the receive buffer pool up front, so the first count sessions to
+  // connect don't allocate either
+  static void preallocate_rx_buffers(size_t count);
+
+  // How replies are matched to requests on the current session: by the
+  // /osc/xid the speaker reflects, or in order if it ignores it
+  enum class XidMode { UNKNOWN, TAGGED, FIFO };
+  // UNKNOWN until the session's first reply
+  XidMode get_xid_mode() const { return xid_mode_; }
+
+  bool is_connected() const { return state_ == State::CONNECTED; }
+  bool is_idle() const { return queue_.empty() && in_flight_.empty(); }
+  bool is_down() const { return health_.link == LinkState::DOWN; }
+  const char *get_ipv6() const { return ipv6_; }
+  const ConnectionHealth &get_health() const { return health_; }
+
+  static const uint32_t CONNECT_TIMEOUT_MS = 300;
+  static const uint32_t REPLY_TIMEOUT_MS = 500;
+  static const uint32_t MIN_TIMEOUT_MS = 100;  // Wi-Fi power save alone can delay a reply this long
+  static const uint32_t MAX_TIMEOUT_MS = 3000;
+  static const size_t MAX_QUEUED = 32;
+  static const size_t MAX_IN_FLIGHT = 8;
+  static const size_t RX_BUFFER_SIZE = 4096;  // Longest message, EQ tables and /osc/schema pages included
+  static const uint32_t DOWN_AFTER_FAILURES = 2;
+  static const uint32_t BACKOFF_MIN_MS = 1000;
+  static const uint32_t BACKOFF_MAX_MS = 30000;
+
+ protected:
+  enum class State { DISCONNECTED, CONNECTING, CONNECTED };
+
+  struct Request {
+    uint32_t xid{0};
+    std::string payload;  // Tagged message including the CR LF separator
+    size_t sent{0};
+    uint32_t started{0};   // millis() when the first byte was written
+    uint32_t deadline{0};  // millis() by which the reply must have arrived
+    bool retried{false};
+    std::string path;  // SSC path a latest-wins write sets, empty otherwise
+    SscCallback callback;
+  };
+
+  bool start_connect_(uint32_t now);
+  bool check_connect_(uint32_t now);
+  void on_connected_(uint32_t now);
+  void connect_failed_(uint32_t now);
+  void journal_write_(Slice command, Slice path);
+  void sample_rtt_(uint32_t rtt_ms);
+  void back_off_timeout_();
+  uint32_t connect_timeout_() const { return health_.timeout_ms != 0 ? health_.timeout_ms : CONNECT_TIMEOUT_MS; }
+  uint32_t reply_timeout_() const { return health_.timeout_ms != 0 ? health_.timeout_ms : REPLY_TIMEOUT_MS; }
+  bool write_pending_(uint32_t now);
+  bool path_in_flight_(const std::string &path) const;
+  bool read_replies_(uint32_t now);
+  void check_timeouts_(uint32_t now);
+  void dispatch_message_(Slice message, uint32_t now);
+  void dispatch_messages_(uint32_t now);
+  bool reserve_rx_();
+  void complete_(std::deque<Request>::iterator it, bool success, Slice response, uint32_t now);
+  void connection_lost_();
+  void fail_all_();
+  size_t max_in_flight_() const { return xid_mode_ == XidMode::TAGGED ? MAX_IN_FLIGHT : 1; }
+
+  const char *ipv6_{""};
+  struct sockaddr_in6 addr_{};
+  int sock_{-1};
+  State state_{State::DISCONNECTED};
+  XidMode xid_mode_{XidMode::UNKNOWN};
+  uint32_t connect_deadline_{0};
+  uint32_t connect_started_{0};
+  uint32_t next_xid_{1};
+  std::deque<Request> queue_;      // Not yet (completely) written
+  std::deque<Request> in_flight_;  // Written, waiting for the reply
+  char *rx_buffer_{nullptr};    // RX_BUFFER_SIZE bytes from the pool while a session is open
+  size_t rx_start_{0};          // First byte not yet handed out
+  size_t rx_end_{0};            // One past the last byte received
+  bool rx_discarding_{false};   // Skipping the rest of an oversized message
+  bool dispatching_{false};     // Slices into rx_buffer_ are out, don't read
+  std::vector<std::pair<std::string, std::string>> journal_;  // path, command of writes refused while DOWN
+  uint32_t failed_connects_{0};    // In a row, reset by a successful connect
+  uint32_t srtt_x8_{0};            // Smoothed RTT in 1/8 ms, so the 1/8 gain does not truncate
+  uint32_t rttvar_x4_{0};          // RTT mean deviation in 1/4 ms
+  SscNotificationHandler notification_handler_;
+  ConnectionHealth health_;
+};
+
+// Fills addr with [ipv6]:45, false if ipv6 is not a valid IPv6 address. The
+// form "[ipv6]:port" selects another port, as emulated speakers need.
+bool parse_ssc_address(const char *ipv6, struct sockaddr_in6 &addr);
+
+// Writes command to payload with "xid":<xid> inserted into its /osc container.
+// The payload's memory is reused, so re-tagging a queued request does not
+// allocate.
+void tag_with_xid(Slice command, uint32_t xid, std::string &payload);
+
+// Reads the /osc/xid a speaker reflected in its reply
+bool extract_xid(Slice message, uint32_t &xid);
+
+}  // namespace network
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,418 @@
+#include "ssc_json.h"
+#include <cstdio>
+
+namespace esphome {
+namespace vol_ctrl {
+
+static inline bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+static inline bool is_digit(char c) { return c >= '0' && c <= '9'; }
+
+void JsonTokenizer::skip_space_() {
+  while (this->pos_ < this->json_.size() && is_space(this->json_[this->pos_])) {
+    this->pos_++;
+  }
+}
+
+JsonToken JsonTokenizer::fail_() {
+  this->failed_ = true;
+  return JsonToken::INVALID;
+}
+
+bool JsonTokenizer::push_(bool object) {
+  if (this->depth_ == MAX_DEPTH) {
+    return false;
+  }
+  if (object) {
+    this->objects_ |= 1u << this->depth_;
+  } else {
+    this->objects_ &= ~(1u << this->depth_);
+  }
+  this->depth_++;
+  return true;
+}
+
+JsonToken JsonTokenizer::next() {
+  if (this->failed_) {
+    return JsonToken::INVALID;
+  }
+  this->skip_space_();
+
+  if (this->after_value_) {
+    // Between values: a separator, the end of the container or of the message
+    if (this->depth_ == 0) {
+      return this->pos_ == this->json_.size() ? JsonToken::END : this->fail_();
+    }
+    if (this->pos_ == this->json_.size()) {
+      return this->fail_();
+    }
+    char c = this->json_[this->pos_];
+    bool object = this->in_object_();
+    if (c == (object ? '}' : ']')) {
+      this->pos_++;
+      this->depth_--;
+      return object ? JsonToken::OBJECT_END : JsonToken::ARRAY_END;
+    }
+    if (c != ',') {
+      return this->fail_();
+    }
+    this->pos_++;
+    this->skip_space_();
+    this->after_value_ = false;
+    if (object) {
+      // A member must follow, not the closing brace
+      if (this->pos_ == this->json_.size() || this->json_[this->pos_] != '"') {
+        return this->fail_();
+      }
+    }
+  }
+
+  if (this->pos_ == this->json_.size()) {
+    return this->fail_();
+  }
+
+  // Member names: only where an object expects one
+  if (this->in_object_() && !this->expect_value_) {
+    char c = this->json_[this->pos_];
+    if (c == '}') {  // Empty object
+      this->pos_++;
+      this->depth_--;
+      this->after_value_ = true;
+      return JsonToken::OBJECT_END;
+    }
+    if (c != '"' || !this->scan_string_()) {
+      return this->fail_();
+    }
+    this->skip_space_();
+    if (this->pos_ == this->json_.size() || this->json_[this->pos_] != ':') {
+      return this->fail_();
+    }
+    this->pos_++;
+    this->expect_value_ = true;
+    return JsonToken::KEY;
+  }
+
+  this->expect_value_ = false;
+  char c = this->json_[this->pos_];
+  switch (c) {
+    case '{':
+      this->pos_++;
+      return this->push_(true) ? JsonToken::OBJECT_BEGIN : this->fail_();
+    case '[':
+      this->pos_++;
+      if (!this->push_(false)) {
+        return this->fail_();
+      }
+      this->skip_space_();
+      if (this->pos_ < this->json_.size() && this->json_[this->pos_] == ']') {
+        this->after_value_ = true;  // Empty array, the next call closes it
+      }
+      return JsonToken::ARRAY_BEGIN;
+    case '"':
+      if (!this->scan_string_()) {
+        return this->fail_();
+      }
+      this->after_value_ = true;
+      return JsonToken::STRING;
+    case 't':
+      if (!this->scan_literal_("true", 4)) {
+        return this->fail_();
+      }
+      this->boolean_ = true;
+      this->after_value_ = true;
+      return JsonToken::BOOLEAN;
+    case 'f':
+      if (!this->scan_literal_("false", 5)) {
+        return this->fail_();
+      }
+      this->boolean_ = false;
+      this->after_value_ = true;
+      return JsonToken::BOOLEAN;
+    case 'n':
+      if (!this->scan_literal_("null", 4)) {
+        return this->fail_();
+      }
+      this->after_value_ = true;
+      return JsonToken::NULL_VALUE;
+    default:
+      if (!this->scan_number_()) {
+        return this->fail_();
+      }
+      this->after_value_ = true;
+      return JsonToken::NUMBER;
+  }
+}
+
+// Sets text_ to the characters between the quotes
+bool JsonTokenizer::scan_string_() {
+  size_t start = ++this->pos_;
+  while (true) {
+    size_t quote = this->json_.find('"', this->pos_);
+    if (quote == Slice::npos) {
+      return false;
+    }
+    // Escaped if preceded by an odd number of backslashes
+    size_t backslashes = 0;
+    while (quote - backslashes > start && this->json_[quote - backslashes - 1] == '\\') {
+      backslashes++;
+    }
+    this->pos_ = quote + 1;
+    if (backslashes % 2 == 0) {
+      this->text_ = this->json_.substr(start, quote - start);
+      return true;
+    }
+  }
+}
+
+bool JsonTokenizer::scan_literal_(const char *literal, size_t length) {
+  if (!this->json_.substr(this->pos_, length).starts_with(Slice(literal, length))) {
+    return false;
+  }
+  this->text_ = this->json_.substr(this->pos_, length);
+  this->pos_ += length;
+  return true;
+}
+
+// Checks the JSON number grammar without converting
+bool JsonTokenizer::scan_number_() {
+  size_t start = this->pos_;
+  size_t size = this->json_.size();
+  if (this->pos_ < size && this->json_[this->pos_] == '-') {
+    this->pos_++;
+  }
+  size_t digits = 0;
+  while (this->pos_ < size && is_digit(this->json_[this->pos_])) {
+    this->pos_++;
+    digits++;
+  }
+  if (this->pos_ < size && this->json_[this->pos_] == '.') {
+    this->pos_++;
+    while (this->pos_ < size && is_digit(this->json_[this->pos_])) {
+      this->pos_++;
+      digits++;
+    }
+  }
+  if (digits == 0) {
+    return false;
+  }
+  if (this->pos_ < size && (this->json_[this->pos_] == 'e' || this->json_[this->pos_] == 'E')) {
+    this->pos_++;
+    if (this->pos_ < size && (this->json_[this->pos_] == '-' || this->json_[this->pos_] == '+')) {
+      this->pos_++;
+    }
+    size_t exponent_digits = 0;
+    while (this->pos_ < size && is_digit(this->json_[this->pos_])) {
+      this->pos_++;
+      exponent_digits++;
+    }
+    if (exponent_digits == 0) {
+      return false;
+    }
+  }
+  this->text_ = this->json_.substr(start, this->pos_ - start);
+  return true;
+}
+
+// Converts the last NUMBER token in place, no strtof() on a copy. SSC values
+// are levels, gains and counters with a few decimals, accumulating the digits
+// in a double is exact enough for them.
+float JsonTokenizer::number() const {
+  Slice text = this->text_;
+  size_t pos = 0;
+  bool negative = text.size() > 0 && text[0] == '-';
+  if (negative) {
+    pos++;
+  }
+  double value = 0.0;
+  while (pos < text.size() && is_digit(text[pos])) {
+    value = value * 10.0 + (text[pos++] - '0');
+  }
+  if (pos < text.size() && text[pos] == '.') {
+    pos++;
+    double scale = 0.1;
+    while (pos < text.size() && is_digit(text[pos])) {
+      value += (text[pos++] - '0') * scale;
+      scale *= 0.1;
+    }
+  }
+  if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+    pos++;
+    bool negative_exponent = pos < text.size() && text[pos] == '-';
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+')) {
+      pos++;
+    }
+    int exponent = 0;
+    while (pos < text.size() && is_digit(text[pos])) {
+      if (exponent < 100) {
+        exponent = exponent * 10 + (text[pos] - '0');
+      }
+      pos++;
+    }
+    for (int i = 0; i < exponent; i++) {
+      value = negative_exponent ? value / 10.0 : value * 10.0;
+    }
+  }
+  return static_cast<float>(negative ? -value : value);
+}
+
+// One open container on the way to the current value
+struct PathLevel {
+  bool array;
+  int index;  // Of the current element, arrays only
+  Slice key;  // Of the current member, objects only
+};
+
+static bool component_matches(Slice component, const PathLevel &level) {
+  if (!level.array) {
+    return component == level.key;
+  }
+  if (component.empty()) {
+    return false;
+  }
+  int index = 0;
+  for (char c : component) {
+    if (c < '0' || c > '9') {
+      return false;
+    }
+    index = index * 10 + (c - '0');
+  }
+  return index == level.index;
+}
+
+static bool path_matches(Slice path, const PathLevel *levels, uint8_t depth) {
+  if (depth == 0) {
+    return false;
+  }
+  if (path.empty() || path[0] != '/') {
+    return !levels[depth - 1].array && path == levels[depth - 1].key;
+  }
+  // Most fields differ in the last member name, reject those before walking the path
+  const PathLevel &leaf = levels[depth - 1];
+  if (!leaf.array) {
+    size_t length = leaf.key.size();
+    if (path.size() <= length || path[path.size() - length - 1] != '/' ||
+        path.substr(path.size() - length) != leaf.key) {
+      return false;
+    }
+  }
+  size_t pos = 0;
+  for (uint8_t d = 0; d < depth; d++) {
+    if (pos == path.size() || path[pos] != '/') {
+      return false;  // Path is shorter than where we are
+    }
+    size_t end = path.find('/', pos + 1);
+    if (end == Slice::npos) {
+      end = path.size();
+    }
+    if (!component_matches(path.substr(pos + 1, end - pos - 1), levels[d])) {
+      return false;
+    }
+    pos = end;
+  }
+  return pos == path.size();
+}
+
+static bool field_accepts(SscField::Type type, JsonToken token) {
+  switch (type) {
+    case SscField::Type::NUMBER:
+      return token == JsonToken::NUMBER;
+    case SscField::Type::BOOLEAN:
+      return token == JsonToken::BOOLEAN;
+    case SscField::Type::STRING:
+      return token == JsonToken::STRING;
+  }
+  return false;
+}
+
+size_t parse_ssc_fields(Slice json, SscField *fields, size_t count) {
+  JsonTokenizer tokenizer(json);
+  PathLevel levels[JsonTokenizer::MAX_DEPTH];
+  uint8_t depth = 0;
+  size_t found = 0;
+  while (found < count) {
+    JsonToken token = tokenizer.next();
+    switch (token) {
+      case JsonToken::END:
+      case JsonToken::INVALID:
+        return found;
+      case JsonToken::KEY:
+        levels[depth - 1].key = tokenizer.text();
+        continue;
+      case JsonToken::OBJECT_END:
+      case JsonToken::ARRAY_END:
+        depth--;
+        continue;
+      default:
+        break;
+    }
+
+    // A value, or a container that is one: it is the next element of an array
+    if (depth > 0 && levels[depth - 1].array) {
+      levels[depth - 1].index++;
+    }
+    if (token == JsonToken::OBJECT_BEGIN || token == JsonToken::ARRAY_BEGIN) {
+      levels[depth].array = token == JsonToken::ARRAY_BEGIN;
+      levels[depth].index = -1;
+      levels[depth].key = Slice();
+      depth++;
+      continue;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      SscField &field = fields[i];
+      if (field.found || !field_accepts(field.type, token) || !path_matches(field.path, levels, depth)) {
+        continue;
+      }
+      switch (field.type) {
+        case SscField::Type::NUMBER:
+          field.number = tokenizer.number();
+          break;
+        case SscField::Type::BOOLEAN:
+          field.boolean = tokenizer.boolean();
+          break;
+        case SscField::Type::STRING:
+          field.string = tokenizer.text();
+          break;
+      }
+      field.found = true;
+      found++;
+    }
+  }
+  return found;
+}
+
+bool ssc_query(Slice json, const char *path, float &value) {
+  SscField field(path, SscField::Type::NUMBER);
+  if (parse_ssc_fields(json, &field, 1) == 0) {
+    return false;
+  }
+  value = field.number;
+  return true;
+}
+
+bool ssc_query(Slice json, const char *path, bool &value) {
+  SscField field(path, SscField::Type::BOOLEAN);
+  if (parse_ssc_fields(json, &field, 1) == 0) {
+    return false;
+  }
+  value = field.boolean;
+  return true;
+}
+
+int ssc_error_status(Slice json, Slice address) {
+  static const char ERROR_PATH[] = "/osc/error/0";
+  char path[64] = "";
+  size_t count = 1;
+  if (!address.empty() && sizeof(ERROR_PATH) + address.size() + 2 <= sizeof(path)) {
+    snprintf(path, sizeof(path), "%s%.*s/0", ERROR_PATH, (int) address.size(), address.data());
+    count = 2;
+  }
+  SscField fields[] = {{ERROR_PATH, SscField::Type::NUMBER}, {path, SscField::Type::NUMBER}};
+  parse_ssc_fields(json, fields, count);
+  if (count == 2 && fields[1].found) {
+    return static_cast<int>(fields[1].number);
+  }
+  return fields[0].found ? static_cast<int>(fields[0].number) : 0;
+}
+
+}  // namespace vol_ctrl
+}  // namespace esphome
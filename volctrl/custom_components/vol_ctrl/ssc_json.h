@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "slice.h"
+
+namespace esphome {
+namespace vol_ctrl {
+
+enum class JsonToken : uint8_t {
+  OBJECT_BEGIN,
+  OBJECT_END,
+  ARRAY_BEGIN,
+  ARRAY_END,
+  KEY,         // Object member name, text() without the quotes
+  STRING,      // text() without the quotes, escapes left as they are
+  NUMBER,      // number() converts it
+  BOOLEAN,     // boolean() has the value
+  NULL_VALUE,  // SSC's "tell me" placeholder in requests
+  END,         // The message is complete
+  INVALID,     // Not JSON, or nested deeper than MAX_DEPTH
+};
+
+// Streaming JSON tokenizer for SSC messages. It walks the message once,
+// front to back, and never allocates: tokens are slices of the message and
+// numbers are converted in place. Separators (':' and ',') are checked and
+// skipped; next() reports INVALID for anything out of place and keeps
+// reporting it.
+class JsonTokenizer {
+ public:
+  static const uint8_t MAX_DEPTH = 32;
+
+  explicit JsonTokenizer(Slice json) : json_(json) {}
+
+  JsonToken next();
+
+  Slice text() const { return text_; }
+  // Converted on demand, most numbers in a reply are not wanted
+  float number() const;
+  bool boolean() const { return boolean_; }
+  // Containers open after the last token
+  uint8_t depth() const { return depth_; }
+
+ protected:
+  bool in_object_() const { return depth_ > 0 && (objects_ >> (depth_ - 1)) & 1; }
+  bool push_(bool object);
+  JsonToken fail_();
+  bool scan_string_();
+  bool scan_number_();
+  bool scan_literal_(const char *literal, size_t length);
+  void skip_space_();
+
+  Slice json_;
+  size_t pos_{0};
+  Slice text_;
+  bool boolean_{false};
+  uint8_t depth_{0};
+  uint32_t objects_{0};       // Bit n set if container n (from the outside) is an object
+  bool expect_value_{false};  // After a key's ':'
+  bool after_value_{false};   // A value or container just ended, ',' or the end may follow
+  bool failed_{false};
+};
+
+// A value the caller wants out of an SSC message, see parse_ssc_fields().
+// The path is an SSC address like "/audio/out/level"; array elements are
+// addressed by their index, e.g. "/audio/out/eq2/gain/3". A path without the
+// leading '/' is a bare member name and matches at any depth.
+struct SscField {
+  enum class Type : uint8_t { NUMBER, BOOLEAN, STRING };
+
+  SscField(const char *path, Type type) : path(path), type(type) {}
+
+  Slice path;
+  Type type;
+  bool found{false};
+  float number{0.0f};
+  bool boolean{false};
+  Slice string;  // Points into the message
+};
+
+// Fills every field whose path appears in json with a value of the field's
+// type, in a single pass and without allocating. The first match wins.
+// Returns how many fields were found; a malformed message keeps what was
+// found before the error.
+size_t parse_ssc_fields(Slice json, SscField *fields, size_t count);
+
+// Single value shorthands for parse_ssc_fields()
+bool ssc_query(Slice json, const char *path, float &value);
+bool ssc_query(Slice json, const char *path, bool &value);
+
+// Status of an /osc/error message, 0 if the message is no error. An error
+// about the message as a whole has the status first in /osc/error; one about
+// a single address repeats the address there with the status first, e.g.
+// /osc/error/0/osc/state/subscribe/0. Pass the address to read that form too.
+int ssc_error_status(Slice json, Slice address = Slice());
+
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,174 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include "slice.h"
+
+namespace esphome {
+namespace vol_ctrl {
+
+// JSON skeleton of one SSC address, built at compile time by ssc_path():
+// "/audio/out/level" becomes the member "audio":{"out":{"level": and the
+// closing }} that follows the value. N is the size of the path literal.
+template<size_t N> struct SscPath {
+  // Each component costs at most its name plus {"": around it
+  char open[3 * N]{};
+  size_t open_size{0};
+  char close[N]{};
+  size_t close_size{0};
+
+  Slice opening() const { return Slice(open, open_size); }
+  Slice closing() const { return Slice(close, close_size); }
+};
+
+template<size_t N> constexpr SscPath<N> ssc_path(const char (&path)[N]) {
+  SscPath<N> skeleton{};
+  size_t depth = 0;
+  for (size_t i = 0; i + 1 < N; i++) {
+    if (path[i] != '/') {
+      skeleton.open[skeleton.open_size++] = path[i];
+      continue;
+    }
+    if (i > 0) {  // Close the previous name and open its object
+      skeleton.open[skeleton.open_size++] = '"';
+      skeleton.open[skeleton.open_size++] = ':';
+      skeleton.open[skeleton.open_size++] = '{';
+      depth++;
+    }
+    skeleton.open[skeleton.open_size++] = '"';
+  }
+  skeleton.open[skeleton.open_size++] = '"';
+  skeleton.open[skeleton.open_size++] = ':';
+  for (size_t i = 0; i < depth; i++) {
+    skeleton.close[skeleton.close_size++] = '}';
+  }
+  return skeleton;
+}
+
+// Fixed-capacity SSC message on the caller's stack: the skeletons are copied
+// in and values are printed straight into the buffer, nothing allocates. A
+// message that does not fit is cut short, and a number too large to print
+// written as 0; overflowed() reports both.
+//
+//   SscMessage<64> message;
+//   message.begin().set(LEVEL, 62.5f).end();  // {"audio":{"out":{"level":62.5}}}
+template<size_t N> class SscMessage {
+ public:
+  const char *data() const { return data_; }
+  size_t size() const { return size_; }
+  bool overflowed() const { return overflowed_; }
+  Slice slice() const { return Slice(data_, size_); }
+  operator Slice() const { return slice(); }
+
+  void clear() {
+    size_ = 0;
+    overflowed_ = false;
+  }
+
+  SscMessage &begin() { return append('{'); }
+  SscMessage &end() { return append('}'); }
+
+  // One member of the message, several may follow each other
+  template<size_t P> SscMessage &set(const SscPath<P> &path, float value, uint8_t decimals = 2) {
+    return member_(path).append_number(value, decimals).append(path.closing());
+  }
+  template<size_t P> SscMessage &set(const SscPath<P> &path, bool value) {
+    return member_(path).append(value ? Slice("true", 4) : Slice("false", 5)).append(path.closing());
+  }
+  // null asks the speaker for the current value
+  template<size_t P> SscMessage &query(const SscPath<P> &path) {
+    return member_(path).append(Slice("null", 4)).append(path.closing());
+  }
+  // Whole arrays, e.g. the gains of an EQ
+  template<size_t P>
+  SscMessage &set(const SscPath<P> &path, const float *values, size_t count, uint8_t decimals = 2) {
+    member_(path).append('[');
+    for (size_t i = 0; i < count; i++) {
+      if (i > 0) {
+        append(',');
+      }
+      append_number(values[i], decimals);
+    }
+    return append(']').append(path.closing());
+  }
+
+  SscMessage &append(char c) {
+    if (size_ < N) {
+      data_[size_++] = c;
+    } else {
+      overflowed_ = true;
+    }
+    return *this;
+  }
+
+  SscMessage &append(Slice text) {
+    size_t length = text.size();
+    if (length > N - size_) {
+      length = N - size_;
+      overflowed_ = true;
+    }
+    memcpy(data_ + size_, text.data(), length);
+    size_ += length;
+    return *this;
+  }
+
+  // Up to decimals places without trailing zeros, no printf and no exponent
+  // notation: SSC levels and gains are small numbers with few decimals
+  SscMessage &append_number(float value, uint8_t decimals = 2) {
+    uint32_t scale = 1;
+    for (uint8_t i = 0; i < decimals; i++) {
+      scale *= 10;
+    }
+    double scaled = std::fabs(static_cast<double>(value)) * scale + 0.5;
+    if (!(scaled < 1e18)) {  // NaN and infinity included, neither is JSON
+      overflowed_ = true;
+      return append('0');
+    }
+    uint64_t fixed = static_cast<uint64_t>(scaled);
+    if (value < 0 && fixed != 0) {
+      append('-');
+    }
+    append_integer_(fixed / scale);
+    uint32_t fraction = static_cast<uint32_t>(fixed % scale);
+    if (fraction != 0) {
+      append('.');
+      for (uint32_t digit = scale / 10; digit > 0 && fraction != 0; digit /= 10) {
+        append(static_cast<char>('0' + fraction / digit));
+        fraction %= digit;
+      }
+    }
+    return *this;
+  }
+
+ protected:
+  template<size_t P> SscMessage &member_(const SscPath<P> &path) {
+    if (size_ > 0 && data_[size_ - 1] != '{') {
+      append(',');
+    }
+    return append(path.opening());
+  }
+
+  void append_integer_(uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+      digits[count++] = static_cast<char>('0' + value % 10);
+      value /= 10;
+    } while (value > 0);
+    while (count > 0) {
+      append(digits[--count]);
+    }
+  }
+
+  char data_[N];
+  size_t size_{0};
+  bool overflowed_{false};
+};
+
+// Capacity for the single value messages the controller sends, time tag included
+static const size_t SSC_COMMAND_SIZE = 96;
+
+}  // namespace vol_ctrl
+}  // namespace esphome
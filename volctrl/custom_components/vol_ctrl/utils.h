@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include "slice.h"
 
 namespace esphome
 {
@@ -10,9 +11,10 @@ namespace esphome
         {
 
             // JSON parsing utilities
-            bool extract_json_value(const std::string &json, const std::string &key, std::string &value);
-            bool check_json_boolean(const std::string &response, const std::string &key, bool &result);
-            bool extract_json_number(const std::string &response, const std::string &key, float &result);
+            // These read SSC replies in place, a std::string converts implicitly
+            bool extract_json_value(Slice json, const std::string &key, std::string &value);
+            bool check_json_boolean(Slice response, const std::string &key, bool &result);
+            bool extract_json_number(Slice response, const std::string &key, float &result);
 
             // Date/time helper functions
             std::string get_datetime_string();
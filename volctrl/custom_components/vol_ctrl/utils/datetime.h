@@ -1,14 +0,0 @@
-#pragma once
-
-#include <string>
-
-namespace esphome {
-namespace vol_ctrl {
-namespace utils {
-
-// Date/time helper functions
-std::string get_datetime_string();
-
-}  // namespace utils
-}  // namespace vol_ctrl
-}  // namespace esphome
@@ -3,11 +3,13 @@
 #include <TFT_eSPI.h>
 #include "esphome/components/wifi/wifi_component.h"
 #include "device_state.h"
+#include "discovery.h"
 #include "display.h"
 #include "network.h"
 #include "utils.h"
 #include "wiim_pro.h"
 #include "esphome/core/hal.h"
+#include "esphome/core/preferences.h"
 #include <esp_sleep.h>
 
 namespace esphome {
@@ -17,6 +19,16 @@ static const char *const TAG = "vol_ctrl";
 uint32_t button_press_time_ = 0;
 WiimPro wiim_pro_;
 
+// Speakers currently reachable, for the dots on the display
+static network::DeviceMask speakers_up() {
+  network::DeviceMask up = 0;
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    if (network::get_device_state(id).is_up)
+      up |= network::device_bit(id);
+  }
+  return up;
+}
+
 void VolCtrl::setup() {
   ESP_LOGCONFIG(TAG, "Setting up Volume Control...");
   
@@ -36,12 +48,26 @@ void VolCtrl::setup() {
   }
   
   // Initialize network subsystem (non-blocking)
-  network::init();  // this registers speaker's IPv6 addresses
+  network::init(this->speakers_, this->speaker_count_);  // this registers speaker's IPv6 addresses
+  network::restore_device_states();  // last known levels, drawn dimmed until the speakers answer
+  network::set_subscriptions_enabled(this->subscribe_);
+  network::set_timetag_sync_enabled(this->sync_volume_);
+  network::set_udp_fast_path_enabled(this->udp_fast_path_);
+  network::set_state_listener([this](network::DeviceId id, const network::DeviceStateUpdate &update) {
+    this->apply_state_update_(id, update);
+  });
+  if (this->network_task_) {
+    network::start_worker();  // Last, the network task reads the settings above
+  }
+  // While the knob is being turned the display shows the requested level
+  this->volume_path_.set_level_listener([this](network::DeviceId id, float volume, bool adjusting) {
+    if (!in_menu_ && !adjusting_brightness_)
+      esphome::vol_ctrl::display::update_volume_display(this->tft_, volume, adjusting);
+  });
   
   main_loop_counter = millis();
   
-  // Add a small delay to let things settle
-  esphome::delay(500);
+  // First frame comes from the boot cache, the speakers' replies update it
   update_whole_screen();
 }
 
@@ -59,88 +85,49 @@ void VolCtrl::loop() {
   // WiFi is connected at this stage
   // Loop as frequently as possible to keep the UI responsive
   // Rotary encoder changes are read by esphome, see yaml lambda
-  const std::map<std::string, DeviceState>& device_states_const = network::get_device_states();
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(device_states_const);  // get list of devices and its states
-
-  // 500ms after last encoder change, we can process the accumulated changes
-  for (auto &entry : device_states) {
-    DeviceState &state = entry.second;
-    float requested_vol = state.get_requested_volume();
-    float last_sent_vol = state.get_last_sent_volume();
-    if (requested_vol > 0.0f && now - this->last_volume_change_ >= 300 && !in_menu_) {  // there was some rotary change
-      // Only call volume_change if requested volume is different from last sent volume
-      if (fabs(requested_vol - last_sent_vol) > 1e-4) {
-        const std::string &ipv6 = entry.first;
-        volume_change(ipv6, requested_vol);
-        state.set_last_sent_volume(requested_vol);
-      }
-    }
-    else
-      break;
-  }
-  if (now - this->last_volume_change_ >= 500 && !in_menu_) {  // reset time to commit the volume
-    this->last_volume_change_ = now;
+  network::DeviceId device_count = network::device_count();
+
+  // With the UDP fast path the knob's levels go out as datagrams; once it has
+  // been still for a moment the last one is committed (and confirmed) over TCP
+  if (!in_menu_) {
+    this->volume_path_.commit(now);
   }
 
-  // every 30 seconds, we check the device states and update the display if needed
+  // Advance pending speaker I/O; completion callbacks update the device states
+  network::loop();
+  network::publish_device_states();  // YAML sensors read this snapshot, never the live table
+
+  // every 10 seconds, we poll one device and update the display if needed
   // Give more time on the first check after WiFi connects
   if (now - this->main_loop_counter > 10000) {
-    bool is_up_changed = false;
-    bool standby_countdown_changed = false;
-    bool volume_changed = false;
-    bool mute_changed = false;
     this->main_loop_counter = now;
-    DeviceState* last_state = nullptr;
     
-    // Process devices one at a time and yield between each to prevent watchdog timeout
-    static size_t device_index = 0;
+    // Poll devices one at a time, the reply is applied by apply_state_update_().
+    // Subscribed devices push their changes and are skipped.
+    static network::DeviceId device_index = 0;
     
-    if (device_states.size() > 0) {
-      auto it = device_states.begin();
-      std::advance(it, device_index % device_states.size());
-      
-      const std::string &ipv6 = it->first;
-      DeviceState &state = it->second;
+    for (network::DeviceId checked = 0; checked < device_count; checked++) {
+      network::DeviceId id = device_index++ % device_count;  // Move to next device for next iteration
+      if (network::is_subscribed(id)) {
+        continue;
+      }
+      DeviceState &state = network::edit_device_state(id);
       state.set_requested_volume(-1.0f);
       
-      ESP_LOGD(TAG, "Checking device status for %s", ipv6.c_str());
-      
-      // Feed the watchdog before potentially blocking network call
-      esphome::yield();
-      
-      network::DeviceVolStdbyData current_device_data;
-      bool is_up = network::get_device_data(ipv6, current_device_data);
-      
-      // Feed the watchdog after network call
-      esphome::yield();
-      
-      is_up_changed |= state.set_is_up(is_up);
-      standby_countdown_changed = state.set_standby_countdown(current_device_data.standby_countdown);
-      volume_changed = state.set_volume(current_device_data.volume);
-      mute_changed = state.set_mute(current_device_data.mute);
-      last_state = &state;
-      
-      device_index++; // Move to next device for next iteration
-      
-      ESP_LOGD(TAG, "Device %s status: %s", ipv6.c_str(), is_up ? "online" : "offline");
+      ESP_LOGD(TAG, "Checking device status for %s", network::get_device_address(id));
+      network::get_device_data(id, [this, id](bool is_up, const network::DeviceVolStdbyData &data) {
+        this->apply_state_update_(id, network::DeviceStateUpdate(is_up, data));
+      });
+      break;
     }
 
-    wiim_pro_.try_reconnect();   // this is fast if connected
+    this->refresh_wiim_();
 
     if (!in_menu_) {
-      // Update changed values on display (every 5sec)
-      if (standby_countdown_changed && last_state)
-        esphome::vol_ctrl::display::update_standby_time(this->tft_, last_state->standby_countdown);
-      if (is_up_changed)
-        esphome::vol_ctrl::display::update_speaker_dots(this->tft_, device_states);
       esphome::vol_ctrl::display::update_datetime(this->tft_, utils::get_datetime_string());
-      if (volume_changed && last_state)
-        esphome::vol_ctrl::display::update_volume_display(this->tft_, last_state->volume);
-      if (mute_changed && last_state)
-        esphome::vol_ctrl::display::update_mute_status(this->tft_, last_state->muted, last_state->volume);
       esphome::vol_ctrl::display::update_status_message(this->tft_, "Long-press for menu");
       esphome::vol_ctrl::display::update_wifi_status(this->tft_, wifi_connected);
-      esphome::vol_ctrl::display::update_wiim_status(this->tft_, wiim_pro_.is_available());
+      esphome::vol_ctrl::display::update_wiim_status(this->tft_, this->wiim_available_);
     }
     
     // Check if all speakers are unavailable for deep sleep timeout
@@ -148,8 +135,8 @@ void VolCtrl::loop() {
       bool any_speaker_available = false;
       
       // Check only regular speakers (WiiM is irrelevant for deep sleep)
-      for (const auto &entry : device_states) {
-        if (entry.second.is_up) {
+      for (network::DeviceId id = 0; id < device_count; id++) {
+        if (network::get_device_state(id).is_up) {
           any_speaker_available = true;
           break;
         }
@@ -167,7 +154,7 @@ void VolCtrl::loop() {
         } else {
           // Check if we've been without speakers for the timeout duration
           uint32_t unavailable_duration = (now - speakers_unavailable_since_) / 1000; // Convert to seconds
-          if (unavailable_duration >= deep_sleep_timeout_) {
+          if (unavailable_duration >= static_cast<uint32_t>(deep_sleep_timeout_)) {
             ESP_LOGI(TAG, "All speakers unavailable for %d seconds, entering deep sleep", unavailable_duration);
             deep_sleep();
           } else {
@@ -184,38 +171,97 @@ void VolCtrl::loop() {
 
 
 void VolCtrl::update_whole_screen() {
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());  // get list of devices and its states
-  DeviceState* last_state = nullptr;
-
-  for (auto &entry : device_states) {  // for every known device
-    const std::string &ipv6 = entry.first;
-    DeviceState &state = entry.second;
-    network::DeviceVolStdbyData current_device_data;
-    bool is_up = network::get_device_data(ipv6, current_device_data);
-    state.set_is_up(is_up);
-    state.set_standby_countdown(current_device_data.standby_countdown);
-    state.set_volume(current_device_data.volume);
-    state.set_mute(current_device_data.mute);
-    last_state = &state; // keep reference to the last processed state
-    
-    // Yield after processing each device to prevent watchdog timeout
-    esphome::yield();
+  const DeviceState* last_state = nullptr;
+
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {  // for every known device
+    // Refresh in the background, apply_state_update_() redraws whatever changed
+    network::get_device_data(id, [this, id](bool is_up, const network::DeviceVolStdbyData &data) {
+      this->apply_state_update_(id, network::DeviceStateUpdate(is_up, data));
+    });
+    last_state = &network::get_device_state(id); // keep reference to the last processed state
   }
   this->tft_->fillScreen(TFT_BLACK);
-  esphome::vol_ctrl::display::update_standby_time(this->tft_, last_state->standby_countdown);
-  esphome::vol_ctrl::display::update_speaker_dots(this->tft_, device_states);
+  if (last_state != nullptr) {
+    esphome::vol_ctrl::display::update_standby_time(this->tft_, last_state->standby_countdown);
+    esphome::vol_ctrl::display::update_volume_display(this->tft_, last_state->volume, false, last_state->stale);
+    esphome::vol_ctrl::display::update_mute_status(this->tft_, last_state->muted, last_state->volume, last_state->stale);
+  }
+  esphome::vol_ctrl::display::update_speaker_dots(this->tft_, speakers_up(), network::device_count());
   esphome::vol_ctrl::display::update_datetime(this->tft_, utils::get_datetime_string());
-  esphome::vol_ctrl::display::update_volume_display(this->tft_, last_state->volume);
-  esphome::vol_ctrl::display::update_mute_status(this->tft_, last_state->muted, last_state->volume);
   esphome::vol_ctrl::display::update_status_message(this->tft_, "Long-press for menu");
   esphome::vol_ctrl::display::update_wifi_status(this->tft_, wifi::global_wifi_component->is_connected());
-  esphome::vol_ctrl::display::update_wiim_status(this->tft_, wiim_pro_.is_available());
+  esphome::vol_ctrl::display::update_wiim_status(this->tft_, this->wiim_available_);
+}
+
+optional<float> VolCtrl::get_link_stat(network::DeviceId id, LinkStat stat) {
+  network::LinkStatsSnapshot stats = network::read_link_stats();
+  if (id >= stats.count || stats.devices[id].smoothed_rtt_ms == 0) {
+    return {};
+  }
+  const network::LinkStats &link = stats.devices[id];
+  switch (stat) {
+    case LinkStat::RTT:
+      return link.smoothed_rtt_ms;
+    case LinkStat::RTT_VARIANCE:
+      return link.rtt_variance_ms;
+    case LinkStat::TIMEOUT:
+      return link.timeout_ms;
+  }
+  return {};
+}
+
+// Applies a status reply, a subscription notification or a failed poll to the
+// cached device state and redraws only what changed
+void VolCtrl::apply_state_update_(network::DeviceId id, const network::DeviceStateUpdate &update) {
+  if (id >= network::device_count()) {
+    return;
+  }
+  DeviceState &state = network::edit_device_state(id);
+  // Heartbeats only carry is_up, the cached level stays stale until a real reading
+  bool was_stale = state.stale && update.has_volume;
+  if (update.has_volume)
+    state.stale = false;
+  bool is_up_changed = state.set_is_up(update.is_up);
+  bool standby_countdown_changed = update.has_standby_countdown && state.set_standby_countdown(update.standby_countdown);
+  bool volume_changed = update.has_volume && state.set_volume(update.volume);
+  bool mute_changed = update.has_mute && state.set_mute(update.mute);
+  ESP_LOGD(TAG, "Device %s status: %s", network::get_device_address(id), update.is_up ? "online" : "offline");
+
+  if (in_menu_ || adjusting_brightness_) {
+    return;
+  }
+  if (standby_countdown_changed)
+    esphome::vol_ctrl::display::update_standby_time(this->tft_, state.standby_countdown);
+  if (is_up_changed)
+    esphome::vol_ctrl::display::update_speaker_dots(this->tft_, speakers_up(), network::device_count());
+  // While the knob is being turned the display keeps showing the requested level
+  if ((volume_changed || was_stale) && state.get_requested_volume() < 0.0f)
+    esphome::vol_ctrl::display::update_volume_display(this->tft_, state.volume);
+  if (mute_changed)
+    esphome::vol_ctrl::display::update_mute_status(this->tft_, state.muted, state.volume);
+}
+
+// Browses for SSC servers in the background; new ones get a speaker dot
+void VolCtrl::discover_devices_() {
+  bool started = network::start_discovery([this](const network::DiscoveryResult &result) {
+    ESP_LOGI(TAG, "Discovery done, %d speakers answered", result.found);
+    if (in_menu_ || adjusting_brightness_) {
+      return;
+    }
+    char message[32];
+    snprintf(message, sizeof(message), "Found %d speakers", result.found);
+    esphome::vol_ctrl::display::update_status_message(this->tft_, message);
+    esphome::vol_ctrl::display::update_speaker_dots(this->tft_, speakers_up(), network::device_count());
+  });
+  if (started) {
+    esphome::vol_ctrl::display::update_status_message(this->tft_, "Discovering speakers");
+  }
 }
 
 // Handle volume change based on encoder ticks. It can be positive or negative.
 // If in menu mode, it will navigate the menu instead.
 // If volume is not initialized yet, it will do nothing.
-void VolCtrl::volume_change(const std::string &ipv6, float requested_volume) {
+void VolCtrl::volume_change(network::DeviceId id, float requested_volume) {
   // Reset deep sleep timer on user interaction
   speakers_unavailable_since_ = 0;
   
@@ -226,16 +272,8 @@ void VolCtrl::volume_change(const std::string &ipv6, float requested_volume) {
     return;
   }
   
-  if (requested_volume < 0.0) {  // volume is not initialized yet
-    return;
-  }
-// TODO make constant setting for maximum volume
-  if (requested_volume > 120.0) {  // volume is over limit
-    return;
-  }
-  network::set_device_volume(ipv6, requested_volume);
-  // Yield control after network operation to prevent watchdog timeout
-  esphome::yield();
+  // Nothing if the volume is not initialized yet or over the limit
+  this->volume_path_.write(id, requested_volume);
 }
 
 void VolCtrl::button_pressed() {
@@ -270,13 +308,10 @@ void VolCtrl::toggle_mute() {
   
   ESP_LOGI(TAG, "Toggling mute state");
   // Determine the current mute state from one of the speakers
-  auto &device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());
-  
   // First, determine what the new state should be
   bool should_mute = false;
-  for (auto &entry : device_states) {
-    DeviceState &state = entry.second;
-    if (!state.muted) {  // If any device is not muted, we should mute all
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    if (!network::get_device_state(id).muted) {  // If any device is not muted, we should mute all
       should_mute = true;
       break;
     }
@@ -294,16 +329,16 @@ void VolCtrl::unmute() {
 
 void VolCtrl::set_mute(bool new_mute) {
   ESP_LOGI(TAG, "Muting all speakers %d", new_mute);
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());
-  
-  // Update local state immediately
-  for (auto &entry : device_states) {
-    network::set_device_mute(entry.first, new_mute);
-    DeviceState &state = entry.second;
+  // Update local state immediately, all speakers get the command in the same pass
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    DeviceState &state = network::edit_device_state(id);
     state.set_mute(new_mute);
     esphome::vol_ctrl::display::update_mute_status(this->tft_, new_mute, state.get_volume());
-    esphome::yield();
   }
+  network::set_group_mute(network::all_devices(), new_mute, [new_mute](const network::GroupResult &result) {
+    ESP_LOGI(TAG, "Mute %d applied on %d of %d speakers, dispatch skew %u us", new_mute, (int) result.succeeded(),
+             (int) result.count, result.dispatch_skew_us);
+  });
 }
 
 
@@ -383,9 +418,10 @@ void VolCtrl::menu_select() {
           menu_position_ = 0;
           menu_items_count_ = 4;
         } else if (menu_position_ == 4) {
-          // Discover devices
-          // This needs to trigger a new network discovery
-          // TODO: Implement discovery trigger
+          // Discover devices, progress is shown on the main screen
+          exit_menu();
+          this->discover_devices_();
+          return;
         } else if (menu_position_ == 5) {
           // Speaker parameters submenu
           menu_level_ = 1;  // Enter speaker parameters submenu
@@ -479,30 +515,35 @@ void VolCtrl::menu_select() {
 
 // This function is only called from Home Assistant service
 void VolCtrl::set_volume_from_hass(float level) {
-  // Ignore volume setting when in menu
-  
   ESP_LOGI(TAG, "Setting volume from Home Assistant to %.1f", level);
   
   // Cap volume level to valid range
-  if (level < 0.0f || level > 120.0f)  // TODO use configurable constant
+  if (level < 0.0f || level > this->volume_path_.get_max_volume())
     return;
 
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());
-  for (auto &entry : device_states) {
-    DeviceState &state = entry.second;
-    const std::string &ipv6 = entry.first;
-    volume_change(ipv6, level);
-    state.set_last_sent_volume(level);
+  // Reset deep sleep timer on user interaction
+  speakers_unavailable_since_ = 0;
+  if (in_menu_) {
+    return;
   }
+
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    network::edit_device_state(id).set_last_sent_volume(level);
+  }
+  // All speakers get the new level in the same pass so they change together
+  network::set_group_volume(network::all_devices(), level, [this, level](const network::GroupResult &result) {
+    for (size_t i = 0; i < result.count; i++) {
+      this->volume_path_.confirm(result.speakers[i].id, level, result.speakers[i].success);
+    }
+    ESP_LOGD(TAG, "Volume %.1f applied on %d of %d speakers, dispatch skew %u us", level, (int) result.succeeded(),
+             (int) result.count, result.dispatch_skew_us);
+  });
 }
 
 // Diff can be negative, see yaml lambda
 void VolCtrl::volume_change_from_hass(float diff) {
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());
-  for (auto &entry : device_states) {
-    DeviceState &state = entry.second;
-    const std::string &ipv6 = entry.first;
-    float current_volume = state.get_volume();
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    float current_volume = network::get_device_state(id).volume;
     if (current_volume < 0.0f) {
       return;
     }
@@ -546,39 +587,23 @@ void VolCtrl::process_encoder_change(int diff) {
   if (fabs(diff) > 10) {
     return;  // Ignore very large changes
   }
-  this->last_volume_change_ = millis();  // volume will commit since last encoder change
   this->main_loop_counter = millis();  // reset device check timer to force update display
   // Not in menu mode, so process volume change
-  std::map<std::string, DeviceState>& device_states = const_cast<std::map<std::string, DeviceState>&>(network::get_device_states());  // get list of devices and its states
-  for (auto &entry : device_states) { 
-    DeviceState &state = entry.second;
-    float requested_vol = state.get_requested_volume();
-    if (requested_vol < 0.0f) {
-      float vol = state.get_volume();
-      if (vol < 0.0f) {
-        ESP_LOGI(TAG, "Requested volume is not set and volume not yet read from device, ignoring encoder change");
-        return;  // No valid volume to change
-      } else {
-        // Since volume from device was confirmed yellow, this is the first rotation diff
-        requested_vol = vol;
-      }
-    }
-    requested_vol = requested_vol + diff;  // TODO handle sensitivity well here
-    state.set_requested_volume(requested_vol);
-    esphome::vol_ctrl::display::update_volume_display(this->tft_, requested_vol, true);
-  }
+  this->volume_path_.encoder_change(diff, millis());
 }
 
 void VolCtrl::pause() {
   ESP_LOGI(TAG, "Pause/Play toggle command received");
   
   // Check if WiiM features are available before attempting command
-  if (wiim_pro_.is_available()) {
-    if (wiim_pro_.pause_play_toggle()) {
-      ESP_LOGI(TAG, "Successfully sent pause/play toggle command to WiiM device");
-    } else {
-      ESP_LOGW(TAG, "Failed to send pause/play toggle command to WiiM device");
-    }
+  if (this->wiim_available_) {
+    network::run_in_background([]() {
+      if (wiim_pro_.pause_play_toggle()) {
+        ESP_LOGI(TAG, "Successfully sent pause/play toggle command to WiiM device");
+      } else {
+        ESP_LOGW(TAG, "Failed to send pause/play toggle command to WiiM device");
+      }
+    });
   } else {
     ESP_LOGD(TAG, "WiiM device not available - pause/play feature disabled");
     ESP_LOGI(TAG, "Pause/Play toggle command - not implemented for KH speakers");
@@ -591,12 +616,14 @@ void VolCtrl::next() {
   ESP_LOGI(TAG, "Next command received");
   
   // Check if WiiM features are available before attempting command
-  if (wiim_pro_.is_available()) {
-    if (wiim_pro_.next()) {
-      ESP_LOGI(TAG, "Successfully sent next command to WiiM device");
-    } else {
-      ESP_LOGW(TAG, "Failed to send next command to WiiM device");
-    }
+  if (this->wiim_available_) {
+    network::run_in_background([]() {
+      if (wiim_pro_.next()) {
+        ESP_LOGI(TAG, "Successfully sent next command to WiiM device");
+      } else {
+        ESP_LOGW(TAG, "Failed to send next command to WiiM device");
+      }
+    });
   } else {
     ESP_LOGD(TAG, "WiiM device not available - next track feature disabled");
     ESP_LOGI(TAG, "Next command - not implemented for KH speakers");
@@ -609,12 +636,16 @@ void VolCtrl::cycle_input() {
   ESP_LOGI(TAG, "Cycle input command received");
   
   // Check if WiiM features are available before attempting command
-  if (wiim_pro_.is_available()) {
-    if (wiim_pro_.cycle_input()) {
+  if (this->wiim_available_) {
+    network::run_in_background([this]() {
+      if (!wiim_pro_.cycle_input()) {
+        ESP_LOGW(TAG, "Failed to cycle input on WiiM device");
+        return;
+      }
       ESP_LOGI(TAG, "Successfully cycled input on WiiM device");
-    } else {
-      ESP_LOGW(TAG, "Failed to cycle input on WiiM device");
-    }
+      std::string input = wiim_pro_.get_current_input();
+      network::run_on_main_loop([this, input]() { this->current_input_ = input; });
+    });
   } else {
     ESP_LOGD(TAG, "WiiM device not available - input cycling feature disabled");
   }
@@ -624,25 +655,41 @@ void VolCtrl::set_input(const std::string &input) {
   ESP_LOGI(TAG, "Set input command received: %s", input.c_str());
   
   // Check if WiiM features are available before attempting command
-  if (wiim_pro_.is_available()) {
-    if (wiim_pro_.set_input(input)) {
+  if (this->wiim_available_) {
+    network::run_in_background([this, input]() {
+      if (!wiim_pro_.set_input(input)) {
+        ESP_LOGW(TAG, "Failed to set input to '%s' on WiiM device", input.c_str());
+        return;
+      }
       ESP_LOGI(TAG, "Successfully set input to '%s' on WiiM device", input.c_str());
-    } else {
-      ESP_LOGW(TAG, "Failed to set input to '%s' on WiiM device", input.c_str());
-    }
+      network::run_on_main_loop([this, input]() { this->current_input_ = input; });
+    });
   } else {
     ESP_LOGD(TAG, "WiiM device not available - input setting feature disabled");
   }
 }
 
+// Served from the cache that refresh_wiim_() keeps up to date, the YAML
+// select polls this and must not wait for the WiiM
 std::string VolCtrl::get_current_input() {
-  // Check if WiiM features are available before attempting to get input
-  if (wiim_pro_.is_available()) {
-    return wiim_pro_.get_current_input();
-  } else {
+  if (!this->wiim_available_) {
     ESP_LOGD(TAG, "WiiM device not available - returning default input");
-    return "Network"; // Default fallback when device is offline
   }
+  return this->current_input_;
+}
+
+// WiiM calls are blocking HTTP/UPnP requests, so they run on the network task
+// and only their results come back to the main loop
+void VolCtrl::refresh_wiim_() {
+  network::run_in_background([this]() {
+    wiim_pro_.try_reconnect();  // this is fast if connected
+    bool available = wiim_pro_.is_available();
+    std::string input = available ? wiim_pro_.get_current_input() : "Network";  // Default fallback when device is offline
+    network::run_on_main_loop([this, available, input]() {
+      this->wiim_available_ = available;
+      this->current_input_ = input;
+    });
+  });
 }
 
 void VolCtrl::set_display_brightness(int brightness) {
@@ -701,6 +748,9 @@ void VolCtrl::deep_sleep() {
   ESP_LOGI(TAG, "Configured wake-up on GPIO25 (encoder button)");
   ESP_LOGI(TAG, "Starting deep sleep now...");
   
+  // Flush the boot cache to flash in case power goes away while asleep
+  global_preferences->sync();
+
   // Small delay to ensure log message is sent
   esphome::delay(100);
   
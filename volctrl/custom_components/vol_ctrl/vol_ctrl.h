@@ -1,12 +1,14 @@
 #pragma once
 
 #include "esphome/core/component.h"
+#include "esphome/core/optional.h"
 #include "esphome/components/spi/spi.h"
 #include "esphome/components/output/float_output.h"
 #include <map>
 #include <string>
 #include "device_state.h"
 #include "network.h"
+#include "volume_path.h"
 
 // Forward-declare the TFT_eSPI class instead of including the whole header
 class TFT_eSPI;
@@ -26,7 +28,7 @@ class VolCtrl : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST
   void update_whole_screen();
 
   // User interface methods
-  void volume_change(const std::string &ipv6, float requested_volume);
+  void volume_change(network::DeviceId id, float requested_volume);
   void button_pressed();
   void button_released();
   void toggle_mute();
@@ -45,7 +47,22 @@ class VolCtrl : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST
   
   // Set backlight control pin
   void set_backlight_pin(output::FloatOutput *backlight_pin) { backlight_pin_ = backlight_pin; }
-  void set_volume_step(float step) { volume_step_ = step; }
+  // Let speakers push state changes instead of being polled
+  void set_subscribe(bool subscribe) { subscribe_ = subscribe; }
+  // Apply group volume changes on all speakers at the same instant via /osc/timetag
+  void set_sync_volume(bool sync_volume) { sync_volume_ = sync_volume; }
+  // Send intermediate encoder levels as SSC datagrams
+  void set_udp_fast_path(bool udp_fast_path) { udp_fast_path_ = udp_fast_path; }
+  // Encoder limits, kept by the volume path
+  void set_max_volume(float max_volume) { volume_path_.set_max_volume(max_volume); }
+  void set_volume_step(float step) { volume_path_.set_step(step); }
+  // Run speaker and WiiM I/O on a separate task instead of in loop()
+  void set_network_task(bool network_task) { network_task_ = network_task; }
+  // Speaker roster from the `speakers:` YAML list, a static table emitted by codegen
+  void set_speakers(const network::SpeakerConfig *speakers, size_t count) {
+    speakers_ = speakers;
+    speaker_count_ = count;
+  }
   
   // Display brightness control (0-100%)
   void set_display_brightness(int brightness);
@@ -71,12 +88,25 @@ class VolCtrl : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST
   // Process encoder changes by directly querying speakers for current volume
   void process_encoder_change(int diff);
 
-  // Helper for HA services
-  const std::map<std::string, DeviceState>& get_device_states() {
-    return network::get_device_states();
+  // Helper for HA services: lock-free copy of the speakers' state
+  DeviceStateSnapshot get_device_snapshot() {
+    return network::read_device_states();
+  }
+  // Helper for diagnostic sensors: lock-free copy of the speakers' round trip statistics
+  network::LinkStatsSnapshot get_link_stats() {
+    return network::read_link_stats();
   }
+  // One of them for the speaker at position id in the speakers list, nothing
+  // until its session has measured a round trip
+  enum class LinkStat { RTT, RTT_VARIANCE, TIMEOUT };
+  optional<float> get_link_stat(network::DeviceId id, LinkStat stat);
 
  protected:
+  // Completion handlers for speaker replies and notifications
+  void apply_state_update_(network::DeviceId id, const network::DeviceStateUpdate &update);
+  void refresh_wiim_();
+  void discover_devices_();
+
   // TFT display instance
   TFT_eSPI *tft_{nullptr};
   
@@ -86,7 +116,16 @@ class VolCtrl : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST
   int menu_position_{0};
   int menu_items_count_{0};
   bool adjusting_brightness_{false};  // Flag to indicate brightness adjustment mode
-  float volume_step_{1.0f};  // Default 1dB steps
+  bool subscribe_{true};  // Use SSC subscriptions, polling is the fallback
+  bool sync_volume_{true};  // Time-tag group volume changes where speakers support it
+  bool udp_fast_path_{false};  // Encoder levels go out over UDP, TCP commits the last one
+  bool network_task_{true};  // I/O on its own task, callbacks still arrive in loop()
+  const network::SpeakerConfig *speakers_{nullptr};
+  size_t speaker_count_{0};
+
+  // WiiM state as last seen by the network task
+  bool wiim_available_{false};
+  std::string current_input_{"Network"};
   
   // Display settings
   int backlight_level_{100};  // 0-100%
@@ -99,8 +138,8 @@ class VolCtrl : public Component, public spi::SPIDevice<spi::BIT_ORDER_MSB_FIRST
   // Backlight control
   output::FloatOutput *backlight_pin_{nullptr};
 
-  // Rate limiting for volume changes
-  uint32_t last_volume_change_{0}; // Timestamp of last volume change to rate limit
+  // Encoder levels on their way to the speakers
+  VolumePath volume_path_;
   uint32_t main_loop_counter{0}; // Counter for main loop timing
   
   bool user_adjusting_volume_{false}; // Flag to indicate user is actively changing volume
@@ -0,0 +1,89 @@
+#include "volume_path.h"
+#include "device_state.h"
+#include "platform.h"
+#include <algorithm>
+#include <cmath>
+
+namespace esphome {
+namespace vol_ctrl {
+
+static const char *const TAG = "vol_ctrl.volume";
+
+bool VolumePath::encoder_change(int diff, uint32_t now) {
+  this->last_change_ = now;
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    DeviceState &state = network::edit_device_state(id);
+    float requested_vol = state.get_requested_volume();
+    if (requested_vol < 0.0f) {
+      float vol = state.get_volume();
+      if (vol < 0.0f) {
+        ESP_LOGI(TAG, "Requested volume is not set and volume not yet read from device, ignoring encoder change");
+        return false;  // No valid volume to change
+      }
+      // Since volume from device was confirmed yellow, this is the first rotation diff
+      requested_vol = vol;
+    }
+    // Clamped, or a long spin past either end would take as long to come back
+    requested_vol = std::min(std::max(requested_vol + diff * this->step_, 0.0f), this->max_volume_);
+    state.set_requested_volume(requested_vol);
+    // Every tick goes to the speaker's latest-wins queue, so a fast spin costs
+    // one write per round trip. With the UDP fast path commit() sends it instead.
+    if (!network::send_volume_datagram(id, requested_vol)) {
+      this->write(id, requested_vol);
+      state.set_last_sent_volume(requested_vol);
+    }
+    if (this->level_listener_) {
+      this->level_listener_(id, requested_vol, true);
+    }
+  }
+  return true;
+}
+
+void VolumePath::commit(uint32_t now) {
+  if (now - this->last_change_ < COMMIT_DELAY_MS) {
+    return;
+  }
+  for (network::DeviceId id = 0; id < network::device_count(); id++) {
+    DeviceState &state = network::edit_device_state(id);
+    float requested_vol = state.get_requested_volume();
+    if (requested_vol >= 0.0f && fabs(requested_vol - state.get_last_sent_volume()) > 1e-4) {
+      this->write(id, requested_vol);
+      state.set_last_sent_volume(requested_vol);
+    }
+  }
+}
+
+bool VolumePath::write(network::DeviceId id, float volume) {
+  if (volume < 0.0f || volume > this->max_volume_) {
+    return false;
+  }
+  return network::set_device_volume(id, volume, [this, id, volume](bool success) {
+    this->confirm(id, volume, success);
+  });
+}
+
+// Once the speaker has confirmed the last level the user asked for, the
+// pending request is cleared so the next encoder tick starts from the
+// speaker's value again
+void VolumePath::confirm(network::DeviceId id, float volume, bool success) {
+  if (!success || id >= network::device_count()) {
+    return;
+  }
+  DeviceState &state = network::edit_device_state(id);
+  float requested_vol = state.get_requested_volume();
+  if (requested_vol >= 0.0f && fabs(requested_vol - volume) > 1e-4) {
+    return;  // Newer encoder ticks are still pending, their write confirms them
+  }
+  bool volume_changed = state.set_volume(volume) || state.stale;
+  state.stale = false;
+  if (requested_vol >= 0.0f) {
+    state.set_requested_volume(-1.0f);
+    volume_changed = true;  // Redraw as confirmed
+  }
+  if (volume_changed && this->level_listener_) {
+    this->level_listener_(id, volume, false);
+  }
+}
+
+}  // namespace vol_ctrl
+}  // namespace esphome
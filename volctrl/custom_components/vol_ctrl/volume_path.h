@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include "network.h"
+
+namespace esphome {
+namespace vol_ctrl {
+
+// The way of a level from the rotary encoder to the speakers, without the UI
+// around it. Every tick moves each speaker's requested level; it goes out at
+// once over the speaker's latest-wins TCP session or, with the UDP fast path,
+// as a datagram that commit() follows up over TCP once the knob has been
+// still for COMMIT_DELAY_MS. A speaker's requested level is cleared when the
+// speaker confirms it, so the next tick starts from the speaker's value again.
+//
+// VolCtrl drives one from the encoder; the host latency simulation
+// (volctrl/host/bench/latency_sim.cpp) drives one from a script.
+class VolumePath {
+ public:
+  static const uint32_t COMMIT_DELAY_MS = 300;
+
+  // Highest level ever written, the top of the speakers' range by default
+  void set_max_volume(float max_volume) { max_volume_ = max_volume; }
+  float get_max_volume() const { return max_volume_; }
+  // Level change per encoder detent
+  void set_step(float step) { step_ = step; }
+
+  // Redraw hook: a level the user is dialling in (adjusting) or one a speaker confirmed
+  using LevelListener = std::function<void(network::DeviceId id, float volume, bool adjusting)>;
+  void set_level_listener(LevelListener listener) { level_listener_ = std::move(listener); }
+
+  // Moves every speaker's requested level by diff steps, within
+  // 0..max_volume. Returns false if a speaker's level has not been read yet,
+  // speakers before it were moved.
+  bool encoder_change(int diff, uint32_t now);
+  // Commits the levels the fast path left unconfirmed once the knob is
+  // still, call on every main loop pass
+  void commit(uint32_t now);
+  // Writes one speaker's level over TCP, false if it is out of range
+  bool write(network::DeviceId id, float volume);
+  // Applies the outcome of a level write to the speaker's state
+  void confirm(network::DeviceId id, float volume, bool success);
+
+  uint32_t last_change() const { return last_change_; }
+
+ protected:
+  LevelListener level_listener_;
+  uint32_t last_change_{0};  // millis() of the last encoder tick
+  float max_volume_{120.0f};
+  float step_{1.0f};  // dB
+};
+
+}  // namespace vol_ctrl
+}  // namespace esphome
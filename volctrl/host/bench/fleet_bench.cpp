@@ -0,0 +1,434 @@
+// How the controller scales with the number of speakers. For each fleet size
+// a child process starts that many emulated speakers on loopback, registers
+// them with the network module and replays the main loop's workloads through
+// it, the way VolCtrl drives it:
+//
+//   encoder  a fast knob spin, one tick per loop pass, every tick a level
+//            write to each speaker (process_encoder_change())
+//   ha       Home Assistant level changes, one group write at a time
+//            (set_volume_from_hass())
+//   mute     mute toggles to the whole group (set_mute())
+//   refresh  a state read of every speaker (update_whole_screen())
+//
+// Each workload prints one JSON object per line:
+//
+//   speakers, workload      fleet size and workload
+//   commands, failed        calls into the network module (one per speaker and
+//                           command) and how many of them reported failure
+//   writes                  values the speakers changed, fewer than commands
+//                           where latest-wins writes coalesced
+//   elapsed_ms              from the first command to the last completion
+//   commands_per_s, writes_per_s
+//   skew_us_p50, skew_us_max
+//                           first to last speaker applying a group write, as
+//                           seen by the emulators (null for reads)
+//   dispatch_skew_us_max    GroupResult::dispatch_skew_us, null for per-speaker
+//                           commands
+//   loops, loop_us_mean, loop_us_p99, loop_us_max
+//                           network::loop() plus publish_device_states(), the
+//                           part of VolCtrl::loop() that grows with the fleet
+//   heap_bytes, heap_peak_bytes
+//                           main thread heap held after the workload and at
+//                           its peak, relative to before network::init()
+//
+//   vol_ctrl_fleet_bench [--speakers 2,4,8,16,32,64] [--rounds N] [--latency MS] [--jitter MS]
+//
+// The emulators run on threads of the same process, so the numbers are only
+// comparable between runs on the same, otherwise idle machine.
+
+#include <malloc.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "network.h"
+#include "platform.h"
+#include "ssc_emulator.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using emulator::EmulatorConfig;
+using emulator::SpeakerEmulator;
+using network::DeviceId;
+
+// Heap held by the controller: only what the main thread allocates is
+// counted, the emulators' threads are left out
+static thread_local bool count_heap = false;
+static int64_t heap_live = 0;
+static int64_t heap_peak = 0;
+
+static void *allocate(size_t size) {
+  void *memory = malloc(size != 0 ? size : 1);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  if (count_heap) {
+    heap_live += malloc_usable_size(memory);
+    heap_peak = std::max(heap_peak, heap_live);
+  }
+  return memory;
+}
+
+static void release(void *memory) {
+  if (memory != nullptr && count_heap) {
+    heap_live -= malloc_usable_size(memory);
+  }
+  free(memory);
+}
+
+// Every form goes straight to malloc() and free(), so scalar and array forms
+// never call each other
+void *operator new(size_t size) { return allocate(size); }
+void *operator new[](size_t size) { return allocate(size); }
+void operator delete(void *memory) noexcept { release(memory); }
+void operator delete[](void *memory) noexcept { release(memory); }
+void operator delete(void *memory, size_t) noexcept { release(memory); }
+void operator delete[](void *memory, size_t) noexcept { release(memory); }
+
+struct Options {
+  std::vector<int> fleet_sizes{2, 4, 8, 16, 32, 64};
+  int rounds = 20;
+  uint32_t latency_ms = 0;
+  uint32_t jitter_ms = 0;
+};
+
+// What one workload measured
+struct Result {
+  explicit Result(const char *workload) : workload(workload) {}
+
+  const char *workload;
+  uint32_t commands = 0;
+  uint32_t failed = 0;
+  uint32_t writes = 0;
+  double elapsed_ms = 0.0;
+  std::vector<uint32_t> skew_us;  // One per group write
+  uint32_t dispatch_skew_us = 0;  // Largest
+  bool group = false;
+  std::vector<double> loop_us;
+  int64_t heap_bytes = 0;
+  int64_t heap_peak_bytes = 0;
+};
+
+static std::vector<std::unique_ptr<SpeakerEmulator>> speakers;
+static int64_t heap_before_init = 0;
+static const uint32_t READY_TIMEOUT_MS = 10000;
+static const uint32_t WORKLOAD_TIMEOUT_MS = 30000;
+
+static double now_us() {
+  using namespace std::chrono;
+  return duration_cast<duration<double, std::micro>>(steady_clock::now().time_since_epoch()).count();
+}
+
+// One main loop pass as far as the speakers are concerned, timed into loop_us
+static void pass(std::vector<double> *loop_us) {
+  double start = now_us();
+  network::loop();
+  network::publish_device_states();
+  if (loop_us != nullptr) {
+    loop_us->push_back(now_us() - start);
+  }
+  usleep(100);  // Leaves the emulators' threads room on small machines
+}
+
+static bool loop_until(const std::function<bool()> &done, std::vector<double> *loop_us, uint32_t timeout_ms) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start > timeout_ms) {
+      return false;
+    }
+    pass(loop_us);
+  }
+  return true;
+}
+
+static uint32_t total_writes() {
+  uint32_t writes = 0;
+  for (auto &speaker : speakers) {
+    writes += speaker->stats().writes;
+  }
+  return writes;
+}
+
+// First to last speaker applying the latest write
+static uint32_t write_skew_us() {
+  uint32_t first = speakers[0]->stats().last_write_us;
+  int32_t min_offset = 0;
+  int32_t max_offset = 0;
+  for (auto &speaker : speakers) {
+    int32_t offset = static_cast<int32_t>(speaker->stats().last_write_us - first);
+    min_offset = std::min(min_offset, offset);
+    max_offset = std::max(max_offset, offset);
+  }
+  return static_cast<uint32_t>(max_offset - min_offset);
+}
+
+static void begin(Result &result) {
+  heap_peak = heap_live;
+  result.writes = total_writes();
+}
+
+static void finish(Result &result, double started_us) {
+  result.elapsed_ms = (now_us() - started_us) / 1000.0;
+  result.writes = total_writes() - result.writes;
+  result.heap_bytes = heap_live - heap_before_init;
+  result.heap_peak_bytes = heap_peak - heap_before_init;
+}
+
+static bool run_encoder(int rounds, Result &result) {
+  begin(result);
+  DeviceId count = network::device_count();
+  uint32_t completed = 0;
+  double started = now_us();
+  for (int tick = 1; tick <= rounds; tick++) {
+    for (DeviceId id = 0; id < count; id++) {
+      network::set_device_volume(id, 50.0f + tick * 0.5f, [&](bool success) {
+        completed++;
+        result.failed += success ? 0 : 1;
+      });
+      result.commands++;
+    }
+    pass(&result.loop_us);
+  }
+  if (!loop_until([&]() { return completed == result.commands; }, &result.loop_us, WORKLOAD_TIMEOUT_MS)) {
+    return false;
+  }
+  finish(result, started);
+  result.skew_us.push_back(write_skew_us());
+  return true;
+}
+
+// One group command at a time, each waiting for the whole group
+static bool run_group(int rounds, const std::function<bool(int, network::GroupCallback)> &command, Result &result) {
+  begin(result);
+  result.group = true;
+  double started = now_us();
+  for (int round = 0; round < rounds; round++) {
+    bool done = false;
+    bool queued = command(round, [&](const network::GroupResult &group) {
+      done = true;
+      result.failed += group.count - group.succeeded();
+      result.dispatch_skew_us = std::max(result.dispatch_skew_us, group.dispatch_skew_us);
+    });
+    result.commands += network::device_count();
+    if (!queued || !loop_until([&]() { return done; }, &result.loop_us, WORKLOAD_TIMEOUT_MS)) {
+      return false;
+    }
+    result.skew_us.push_back(write_skew_us());
+  }
+  finish(result, started);
+  return true;
+}
+
+static bool run_refresh(int rounds, Result &result) {
+  begin(result);
+  DeviceId count = network::device_count();
+  double started = now_us();
+  for (int round = 0; round < rounds; round++) {
+    uint32_t completed = 0;
+    for (DeviceId id = 0; id < count; id++) {
+      network::get_device_data(id, [&](bool is_up, const network::DeviceVolStdbyData &) {
+        completed++;
+        result.failed += is_up ? 0 : 1;
+      });
+      result.commands++;
+    }
+    if (!loop_until([&]() { return completed == count; }, &result.loop_us, WORKLOAD_TIMEOUT_MS)) {
+      return false;
+    }
+  }
+  finish(result, started);
+  return true;
+}
+
+template<typename T> static T percentile(std::vector<T> values, int percent) {
+  if (values.empty()) {
+    return T();
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+static void report(int fleet_size, const Result &result) {
+  double seconds = result.elapsed_ms / 1000.0;
+  double loop_total = 0.0;
+  for (double loop : result.loop_us) {
+    loop_total += loop;
+  }
+  char skew[64] = "null,\"skew_us_max\":null";
+  if (!result.skew_us.empty()) {
+    snprintf(skew, sizeof(skew), "%u,\"skew_us_max\":%u", percentile(result.skew_us, 50),
+             *std::max_element(result.skew_us.begin(), result.skew_us.end()));
+  }
+  char dispatch_skew[16] = "null";
+  if (result.group) {
+    snprintf(dispatch_skew, sizeof(dispatch_skew), "%u", result.dispatch_skew_us);
+  }
+  printf("{\"speakers\":%d,\"workload\":\"%s\",\"commands\":%u,\"failed\":%u,\"writes\":%u,\"elapsed_ms\":%.2f,"
+         "\"commands_per_s\":%.0f,\"writes_per_s\":%.0f,\"skew_us_p50\":%s,\"dispatch_skew_us_max\":%s,"
+         "\"loops\":%zu,\"loop_us_mean\":%.2f,\"loop_us_p99\":%.2f,\"loop_us_max\":%.2f,"
+         "\"heap_bytes\":%lld,\"heap_peak_bytes\":%lld}\n",
+         fleet_size, result.workload, result.commands, result.failed, result.writes, result.elapsed_ms,
+         result.commands / seconds, result.writes / seconds, skew, dispatch_skew, result.loop_us.size(),
+         result.loop_us.empty() ? 0.0 : loop_total / result.loop_us.size(), percentile(result.loop_us, 99),
+         result.loop_us.empty() ? 0.0 : *std::max_element(result.loop_us.begin(), result.loop_us.end()),
+         static_cast<long long>(result.heap_bytes), static_cast<long long>(result.heap_peak_bytes));
+  fflush(stdout);
+}
+
+// Runs all workloads against fleet_size speakers, in a process of its own:
+// the network module's device table cannot be emptied again
+static int run_fleet(int fleet_size, const Options &options) {
+  EmulatorConfig config;
+  config.address = "::1";
+  config.port = 0;
+  config.latency_ms = options.latency_ms;
+  config.jitter_ms = options.jitter_ms;
+  std::vector<std::string> addresses;
+  std::vector<std::string> names;
+  for (int i = 0; i < fleet_size; i++) {
+    config.seed = i + 1;
+    speakers.emplace_back(new SpeakerEmulator(config));
+    if (!speakers.back()->start()) {
+      fprintf(stderr, "Speaker %d did not start\n", i);
+      return 1;
+    }
+    addresses.push_back(speakers.back()->loopback_address());
+    names.push_back("Speaker " + std::to_string(i + 1));
+  }
+  std::vector<network::SpeakerConfig> roster;
+  for (int i = 0; i < fleet_size; i++) {
+    roster.push_back({names[i].c_str(), addresses[i].c_str(), network::SpeakerRole::FULL_RANGE, 0, 0.0f});
+  }
+
+  count_heap = true;
+  heap_before_init = heap_live;
+  network::init(roster.data(), roster.size());
+  network::set_subscriptions_enabled(true);
+  network::set_timetag_sync_enabled(true);
+  if (network::device_count() != fleet_size) {
+    fprintf(stderr, "Only %d of %d speakers registered\n", network::device_count(), fleet_size);
+    return 1;
+  }
+
+  // Sessions up, subscriptions and time tag support known, and a first level
+  // so that every speaker has a round trip estimate for synchronised writes
+  bool ready = loop_until([]() {
+    for (DeviceId id = 0; id < network::device_count(); id++) {
+      if (!network::is_subscribed(id) || !network::supports_timetag(id)) {
+        return false;
+      }
+    }
+    return true;
+  }, nullptr, READY_TIMEOUT_MS);
+  bool warmed_up = false;
+  ready = ready && network::set_group_volume(network::all_devices(), 50.0f, [&](const network::GroupResult &) {
+    warmed_up = true;
+  });
+  if (!ready || !loop_until([&]() { return warmed_up; }, nullptr, READY_TIMEOUT_MS)) {
+    fprintf(stderr, "%d speakers did not get ready\n", fleet_size);
+    return 1;
+  }
+
+  Result encoder{"encoder"};
+  Result ha{"ha"};
+  Result mute{"mute"};
+  Result refresh{"refresh"};
+  bool ok = run_encoder(options.rounds * 2, encoder) &&
+            run_group(options.rounds, [](int round, network::GroupCallback callback) {
+              return network::set_group_volume(network::all_devices(), 40.0f + round % 10, std::move(callback));
+            }, ha) &&
+            run_group(options.rounds, [](int round, network::GroupCallback callback) {
+              return network::set_group_mute(network::all_devices(), round % 2 == 0, std::move(callback));
+            }, mute) &&
+            run_refresh(options.rounds, refresh);
+  count_heap = false;
+  if (!ok) {
+    fprintf(stderr, "A workload timed out with %d speakers\n", fleet_size);
+    return 1;
+  }
+  for (const Result *result : {&encoder, &ha, &mute, &refresh}) {
+    report(fleet_size, *result);
+  }
+  // Skips the emulators' destructors, the process ends here anyway
+  fflush(stdout);
+  _exit(0);
+}
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: vol_ctrl_fleet_bench [options]\n"
+          "  --speakers N,N,...     fleet sizes, at most %d (default 2,4,8,16,32,64)\n"
+          "  --rounds N             commands per workload (default 20)\n"
+          "  --latency MS           speaker turnaround (default 0)\n"
+          "  --jitter MS            uniform extra turnaround up to MS (default 0)\n",
+          network::MAX_DEVICES);
+}
+
+static bool parse_fleet_sizes(const char *value, std::vector<int> &sizes) {
+  sizes.clear();
+  const char *start = value;
+  while (*start != '\0') {
+    char *end;
+    long size = strtol(start, &end, 10);
+    if (end == start || size < 1 || size > network::MAX_DEVICES) {
+      return false;
+    }
+    sizes.push_back(static_cast<int>(size));
+    start = *end == ',' ? end + 1 : end;
+  }
+  return !sizes.empty();
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[++i] : nullptr;
+    bool valid = value != nullptr;
+    if (valid && strcmp(arg, "--speakers") == 0) {
+      valid = parse_fleet_sizes(value, options.fleet_sizes);
+    } else if (valid && strcmp(arg, "--rounds") == 0) {
+      options.rounds = atoi(value);
+      valid = options.rounds > 0;
+    } else if (valid && strcmp(arg, "--latency") == 0) {
+      options.latency_ms = static_cast<uint32_t>(atoi(value));
+    } else if (valid && strcmp(arg, "--jitter") == 0) {
+      options.jitter_ms = static_cast<uint32_t>(atoi(value));
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      usage();
+      return 2;
+    }
+  }
+
+  int failures = 0;
+  for (int fleet_size : options.fleet_sizes) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (child == 0) {
+      _exit(run_fleet(fleet_size, options));
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failures++;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
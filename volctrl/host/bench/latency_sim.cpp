@@ -0,0 +1,391 @@
+// Knob-to-speaker latency of the volume path, simulated deterministically.
+// Time is virtual (host_virtual_time_us(), see platform.h) and advances in
+// 1 ms steps. In each step the emulated speakers run first, then one main
+// loop pass the way VolCtrl::loop() makes it: VolumePath::commit(),
+// network::loop(), publish_device_states(). The sockets are real loopback
+// sockets, everything runs on one thread, so a run with the same options
+// always gives the same numbers.
+//
+// A script of encoder gestures is fed to VolumePath::encoder_change(), the
+// code behind process_encoder_change(). Each gesture is a number of ticks a
+// fixed interval apart, followed by a pause that lets everything settle. A
+// tick's latency is the time until its speaker applies that tick's level or
+// a later one: a tick that a latest-wins write superseded is served by the
+// write that replaced it.
+//
+// One JSON object per line for every gesture and path, and one with the
+// gesture "all" per path:
+//
+//   path                     "tcp" (every tick over the speaker's session) or
+//                            "udp" (the datagram fast path with the TCP commit)
+//   gesture, ticks           gesture and its encoder ticks
+//   samples                  ticks times speakers
+//   p50_ms, p95_ms, p99_ms, max_ms
+//                            tick latency
+//   final_ms                 worst latency of a gesture's last tick, until the
+//                            level the user stopped at is in place
+//   missed                   samples whose level never arrived
+//   writes                   level changes the speakers applied
+//   intermediate_writes      of which not the gesture's final level
+//   datagrams                SSC datagrams the speakers received
+//
+//   vol_ctrl_latency_sim [--path tcp|udp|both] [--speakers N] [--latency MS] [--jitter MS]
+//                        [--loss P] [--seed N]
+//
+// --latency and --jitter are the speakers' turnaround including the network
+// round trip, see EmulatorConfig.
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "network.h"
+#include "platform.h"
+#include "ssc_emulator.h"
+#include "volume_path.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using emulator::EmulatorConfig;
+using emulator::SpeakerEmulator;
+using network::DeviceId;
+
+// Ticks interval_ms apart, then settle_ms of stillness
+struct Gesture {
+  const char *name;
+  int ticks;
+  uint32_t interval_ms;
+  int diff;
+  uint32_t settle_ms;
+};
+
+// A single click, a slow turn, a steady spin and a flick, each way
+static const Gesture SCRIPT[] = {
+    {"click", 1, 0, 1, 1500},      {"click", 1, 0, -1, 1500},     {"slow", 8, 150, 1, 1500},
+    {"slow", 8, 150, -1, 1500},    {"spin", 30, 20, 1, 1500},     {"spin", 30, 20, -1, 1500},
+    {"flick", 12, 4, 1, 1500},     {"flick", 12, 4, -1, 1500},
+};
+static const char *const GESTURES[] = {"click", "slow", "spin", "flick"};
+
+struct Options {
+  bool tcp = true;
+  bool udp = true;
+  int speakers = 2;
+  uint32_t latency_ms = 8;
+  uint32_t jitter_ms = 4;
+  float loss = 0.0f;
+  uint32_t seed = 1;
+};
+
+// One encoder tick as one speaker sees it
+struct Tick {
+  size_t gesture;  // Index into SCRIPT
+  bool last;       // The gesture's final level
+  uint32_t issued_us;
+  float level;
+  bool applied = false;
+  uint32_t latency_us = 0;
+};
+
+struct Speaker {
+  std::unique_ptr<SpeakerEmulator> emulator;
+  std::string address;
+  std::string name;
+  std::vector<Tick> ticks;
+  size_t first_open = 0;        // Ticks before this one are applied
+  std::vector<size_t> writes;   // Level changes applied, per gesture
+  std::vector<size_t> finals;   // Of which the gesture's final level, per gesture
+  std::vector<uint32_t> datagrams;  // Per gesture
+};
+
+static std::vector<Speaker> speakers;
+static VolumePath volume_path;
+static size_t current_gesture = 0;
+
+static void advance(uint32_t ms) {
+  for (uint32_t i = 0; i < ms; i++) {
+    host_virtual_time_us() += 1000;
+    for (Speaker &speaker : speakers) {
+      speaker.emulator->step();
+    }
+    volume_path.commit(millis());
+    network::loop();
+    network::publish_device_states();
+  }
+}
+
+static bool advance_until(const std::function<bool()> &done, uint32_t timeout_ms) {
+  for (uint32_t waited = 0; !done(); waited++) {
+    if (waited == timeout_ms) {
+      return false;
+    }
+    advance(1);
+  }
+  return true;
+}
+
+// A level arrived at the speaker: the latest tick that asked for it, and every
+// open tick before that, are served
+static void level_applied(Speaker &speaker, float level) {
+  uint32_t now = micros();
+  speaker.writes[current_gesture]++;
+  size_t served = speaker.ticks.size();
+  for (size_t i = speaker.ticks.size(); i-- > speaker.first_open;) {
+    if (std::fabs(speaker.ticks[i].level - level) < 1e-3f) {
+      served = i;
+      break;
+    }
+  }
+  if (served == speaker.ticks.size()) {
+    return;  // Not a level of this script, e.g. the initial one
+  }
+  if (speaker.ticks[served].last) {
+    speaker.finals[speaker.ticks[served].gesture]++;
+  }
+  for (size_t i = speaker.first_open; i <= served; i++) {
+    Tick &tick = speaker.ticks[i];
+    if (!tick.applied) {
+      tick.applied = true;
+      tick.latency_us = now - tick.issued_us;
+    }
+  }
+  speaker.first_open = served + 1;
+}
+
+// Mirrors VolCtrl::apply_state_update_() as far as the levels go
+static void apply_state_update(DeviceId id, const network::DeviceStateUpdate &update) {
+  DeviceState &state = network::edit_device_state(id);
+  state.set_is_up(update.is_up);
+  if (update.has_volume) {
+    state.stale = false;
+    state.set_volume(update.volume);
+  }
+  if (update.has_mute) {
+    state.set_mute(update.mute);
+  }
+}
+
+static double percentile_ms(std::vector<uint32_t> values, int percent) {
+  if (values.empty()) {
+    return 0.0;
+  }
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, values.size() * percent / 100)] / 1000.0;
+}
+
+// Prints the line for the gestures called name, or all of them for nullptr
+static void report(const char *path, const char *name) {
+  int ticks = 0;
+  std::vector<uint32_t> latencies;
+  uint32_t final_us = 0;
+  int missed = 0;
+  size_t writes = 0;
+  size_t intermediate_writes = 0;
+  uint32_t datagrams = 0;
+  for (size_t g = 0; g < sizeof(SCRIPT) / sizeof(SCRIPT[0]); g++) {
+    if (name != nullptr && strcmp(SCRIPT[g].name, name) != 0) {
+      continue;
+    }
+    ticks += SCRIPT[g].ticks;
+    for (const Speaker &speaker : speakers) {
+      for (const Tick &tick : speaker.ticks) {
+        if (tick.gesture != g) {
+          continue;
+        }
+        if (!tick.applied) {
+          missed++;
+          continue;
+        }
+        latencies.push_back(tick.latency_us);
+        if (tick.last) {
+          final_us = std::max(final_us, tick.latency_us);
+        }
+      }
+      writes += speaker.writes[g];
+      intermediate_writes += speaker.writes[g] - speaker.finals[g];
+      datagrams += speaker.datagrams[g];
+    }
+  }
+  printf("{\"path\":\"%s\",\"gesture\":\"%s\",\"ticks\":%d,\"samples\":%zu,\"p50_ms\":%.1f,\"p95_ms\":%.1f,"
+         "\"p99_ms\":%.1f,\"max_ms\":%.1f,\"final_ms\":%.1f,\"missed\":%d,\"writes\":%zu,"
+         "\"intermediate_writes\":%zu,\"datagrams\":%u}\n",
+         path, name != nullptr ? name : "all", ticks, latencies.size(), percentile_ms(latencies, 50),
+         percentile_ms(latencies, 95), percentile_ms(latencies, 99), percentile_ms(latencies, 100),
+         final_us / 1000.0, missed, writes, intermediate_writes, datagrams);
+}
+
+// Runs the script over one path, in a process of its own: the network
+// module's device table and settings stay for good
+static int simulate(bool udp, const Options &options) {
+  host_virtual_time_us() = 1000000;
+
+  EmulatorConfig config;
+  config.address = "::1";
+  config.port = 0;
+  config.latency_ms = options.latency_ms;
+  config.jitter_ms = options.jitter_ms;
+  config.loss = options.loss;
+  config.threaded = false;
+  speakers.resize(options.speakers);
+  size_t gestures = sizeof(SCRIPT) / sizeof(SCRIPT[0]);
+  for (int i = 0; i < options.speakers; i++) {
+    Speaker &speaker = speakers[i];
+    config.seed = options.seed + i;
+    speaker.emulator.reset(new SpeakerEmulator(config));
+    if (!speaker.emulator->start()) {
+      fprintf(stderr, "Speaker %d did not start\n", i);
+      return 1;
+    }
+    speaker.address = speaker.emulator->loopback_address();
+    speaker.name = "Speaker " + std::to_string(i + 1);
+    speaker.writes.assign(gestures, 0);
+    speaker.finals.assign(gestures, 0);
+    speaker.datagrams.assign(gestures, 0);
+    speaker.emulator->set_level_listener([&speaker](float level) { level_applied(speaker, level); });
+  }
+  std::vector<network::SpeakerConfig> roster;
+  for (Speaker &speaker : speakers) {
+    roster.push_back({speaker.name.c_str(), speaker.address.c_str(), network::SpeakerRole::FULL_RANGE, 0, 0.0f});
+  }
+
+  network::init(roster.data(), roster.size());
+  network::set_subscriptions_enabled(true);
+  network::set_timetag_sync_enabled(true);
+  network::set_udp_fast_path_enabled(udp);
+  network::set_state_listener(apply_state_update);
+
+  // Sessions up and every speaker's level known, as after boot
+  for (DeviceId id = 0; id < network::device_count(); id++) {
+    network::get_device_data(id, [id](bool is_up, const network::DeviceVolStdbyData &data) {
+      apply_state_update(id, network::DeviceStateUpdate(is_up, data));
+    });
+  }
+  bool ready = advance_until([]() {
+    for (DeviceId id = 0; id < network::device_count(); id++) {
+      if (!network::is_subscribed(id) || network::get_device_state(id).volume < 0.0f) {
+        return false;
+      }
+    }
+    return true;
+  }, 10000);
+  if (!ready) {
+    fprintf(stderr, "The speakers did not get ready\n");
+    return 1;
+  }
+
+  for (current_gesture = 0; current_gesture < gestures; current_gesture++) {
+    const Gesture &gesture = SCRIPT[current_gesture];
+    std::vector<uint32_t> datagrams_before;
+    for (Speaker &speaker : speakers) {
+      datagrams_before.push_back(speaker.emulator->stats().datagrams);
+    }
+    for (int i = 0; i < gesture.ticks; i++) {
+      if (i > 0) {
+        advance(gesture.interval_ms);
+      }
+      // Each speaker moves from its own requested (or confirmed) level
+      for (DeviceId id = 0; id < network::device_count(); id++) {
+        const DeviceState &state = network::get_device_state(id);
+        float from = state.requested_volume >= 0.0f ? state.requested_volume : state.volume;
+        Tick tick;
+        tick.gesture = current_gesture;
+        tick.last = i == gesture.ticks - 1;
+        tick.issued_us = micros();
+        tick.level = from + gesture.diff;
+        speakers[id].ticks.push_back(tick);
+      }
+      if (!volume_path.encoder_change(gesture.diff, millis())) {
+        fprintf(stderr, "The encoder tick was ignored\n");
+        return 1;
+      }
+    }
+    advance(gesture.settle_ms);
+    for (size_t i = 0; i < speakers.size(); i++) {
+      speakers[i].datagrams[current_gesture] = speakers[i].emulator->stats().datagrams - datagrams_before[i];
+    }
+  }
+
+  const char *path = udp ? "udp" : "tcp";
+  for (const char *name : GESTURES) {
+    report(path, name);
+  }
+  report(path, nullptr);
+  fflush(stdout);
+  for (Speaker &speaker : speakers) {
+    speaker.emulator->stop();
+  }
+  return 0;
+}
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: vol_ctrl_latency_sim [options]\n"
+          "  --path tcp|udp|both    volume path to simulate (default both)\n"
+          "  --speakers N           number of speakers (default 2)\n"
+          "  --latency MS           speaker turnaround (default 8)\n"
+          "  --jitter MS            uniform extra turnaround up to MS (default 4)\n"
+          "  --loss P               packet loss probability 0..1 (default 0)\n"
+          "  --seed N               random seed (default 1)\n");
+}
+
+int main(int argc, char **argv) {
+  Options options;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[++i] : nullptr;
+    bool valid = value != nullptr;
+    if (valid && strcmp(arg, "--path") == 0) {
+      options.tcp = strcmp(value, "udp") != 0;
+      options.udp = strcmp(value, "tcp") != 0;
+      valid = options.tcp || options.udp;
+    } else if (valid && strcmp(arg, "--speakers") == 0) {
+      options.speakers = atoi(value);
+      valid = options.speakers > 0 && options.speakers <= network::MAX_DEVICES;
+    } else if (valid && strcmp(arg, "--latency") == 0) {
+      options.latency_ms = static_cast<uint32_t>(atoi(value));
+    } else if (valid && strcmp(arg, "--jitter") == 0) {
+      options.jitter_ms = static_cast<uint32_t>(atoi(value));
+    } else if (valid && strcmp(arg, "--loss") == 0) {
+      options.loss = static_cast<float>(atof(value));
+    } else if (valid && strcmp(arg, "--seed") == 0) {
+      options.seed = static_cast<uint32_t>(atoi(value));
+    } else {
+      valid = false;
+    }
+    if (!valid) {
+      usage();
+      return 2;
+    }
+  }
+
+  int failures = 0;
+  for (bool udp : {false, true}) {
+    if (!(udp ? options.udp : options.tcp)) {
+      continue;
+    }
+    fflush(stdout);
+    pid_t child = fork();
+    if (child < 0) {
+      perror("fork");
+      return 1;
+    }
+    if (child == 0) {
+      _exit(simulate(udp, options));
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failures++;
+    }
+  }
+  return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,242 @@
+// Parse and encode throughput of the SSC core. Run on an otherwise idle
+// machine and compare against a baseline with
+//   vol_ctrl_bench --benchmark_out=new.json --benchmark_out_format=json
+//   compare.py benchmarks old.json new.json  (from Google Benchmark's tools)
+
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+
+#include "ssc_connection.h"
+#include "ssc_json.h"
+#include "ssc_message.h"
+#include "platform.h"
+#include "utils.h"
+
+using namespace esphome::vol_ctrl;
+
+// Reply to the state read, what every poll and notification parses
+static const char STATE_REPLY[] =
+    "{\"osc\":{\"xid\":1234},\"device\":{\"standby\":{\"countdown\":5400}},"
+    "\"audio\":{\"out\":{\"level\":62.5,\"mute\":false}}}";
+
+// A long reply with the wanted value at the end
+static std::string eq_reply() {
+  std::string reply = "{\"osc\":{\"xid\":99},\"audio\":{\"out\":{\"eq2\":{\"gain\":[";
+  for (int band = 0; band < 20; band++) {
+    reply += (band > 0 ? "," : "") + std::to_string(band * -0.5);
+  }
+  reply += "],\"frequency\":[";
+  for (int band = 0; band < 20; band++) {
+    reply += (band > 0 ? "," : "") + std::to_string(20 * (band + 1));
+  }
+  return reply + "]},\"level\":70}}}";
+}
+
+static void BM_TokenizeStateReply(benchmark::State &state) {
+  for (auto _ : state) {
+    JsonTokenizer tokenizer(STATE_REPLY);
+    int tokens = 0;
+    while (tokenizer.next() != JsonToken::END) {
+      tokens++;
+    }
+    benchmark::DoNotOptimize(tokens);
+  }
+  state.SetBytesProcessed(state.iterations() * (sizeof(STATE_REPLY) - 1));
+}
+BENCHMARK(BM_TokenizeStateReply);
+
+static void BM_ParseStateReply(benchmark::State &state) {
+  for (auto _ : state) {
+    SscField fields[] = {{"/audio/out/level", SscField::Type::NUMBER},
+                         {"/audio/out/mute", SscField::Type::BOOLEAN},
+                         {"/device/standby/countdown", SscField::Type::NUMBER}};
+    benchmark::DoNotOptimize(parse_ssc_fields(STATE_REPLY, fields, 3));
+    benchmark::DoNotOptimize(fields[0].number);
+  }
+  state.SetBytesProcessed(state.iterations() * (sizeof(STATE_REPLY) - 1));
+}
+BENCHMARK(BM_ParseStateReply);
+
+// The key by key helpers as they were before the tokenizer, copied verbatim
+// from utils.cpp so the baseline stays put while utils moves on
+namespace before_tokenizer {
+
+static const char *const TAG = "vol_ctrl.utils";
+
+static bool check_json_boolean(Slice response, const std::string &key, bool &result) {
+  ESP_LOGD(TAG, "Checking for boolean key '%s' in JSON: %.*s", key.c_str(), (int) response.size(), response.data());
+  // Look for the key with proper JSON format
+  std::string key_pattern = "\"" + key + "\":";
+  size_t pos = response.find(key_pattern);
+  if (pos == Slice::npos) {
+    ESP_LOGW(TAG, "Key '%s' not found in JSON response", key.c_str());
+    return false;
+  }
+  
+  // Move position to after the key and colon
+  pos += key_pattern.length();
+  
+  // Skip any whitespace
+  while (pos < response.size() && (response[pos] == ' ' || response[pos] == '\t' || 
+         response[pos] == '\n' || response[pos] == '\r')) {
+    pos++;
+  }
+  
+  // Check if we have enough characters left
+  if (pos + 4 >= response.size()) {
+    ESP_LOGW(TAG, "Not enough characters after key '%s'", key.c_str());
+    return false;
+  }
+  
+  // Check for "true" or "false" specifically at this position
+  if (response.substr(pos, 4) == "true") {
+    result = true;
+    ESP_LOGD(TAG, "Found value 'true' for key '%s'", key.c_str());
+    return true;
+  } else if (response.substr(pos, 5) == "false") {
+    result = false;
+    ESP_LOGD(TAG, "Found value 'false' for key '%s'", key.c_str());
+    return true;
+  }
+  
+  ESP_LOGW(TAG, "Value for key '%s' is neither 'true' nor 'false'", key.c_str());
+  return false;
+  
+  return false;
+}
+
+static bool extract_json_number(Slice response, const std::string &key, float &result) {
+  ESP_LOGD(TAG, "Extracting '%s' from JSON: %.*s", key.c_str(), (int) response.size(), response.data());
+  std::string key_pattern = "\"" + key + "\":";
+  size_t pos = response.find(key_pattern);
+  if (pos == Slice::npos) {
+    ESP_LOGE(TAG, "Key '%s' not found in response", key.c_str());
+    return false;
+  }
+  
+  pos += key.length() + 3; // Skip past "key":
+  size_t end_pos = pos;
+  while (end_pos < response.size() && response[end_pos] != ',' && response[end_pos] != '}') {
+    end_pos++;
+  }
+  if (end_pos == response.size()) {
+    ESP_LOGE(TAG, "End of value for '%s' not found", key.c_str());
+    return false;
+  }
+  
+  std::string value = response.substr(pos, end_pos - pos).to_string();
+  ESP_LOGD(TAG, "Raw extracted value for '%s': '%s'", key.c_str(), value.c_str());
+  
+  // Remove whitespace
+  size_t first = value.find_first_not_of(" \t\n\r");
+  size_t last = value.find_last_not_of(" \t\n\r");
+  if (first == std::string::npos || last == std::string::npos) {
+    ESP_LOGE(TAG, "Value for '%s' contains only whitespace", key.c_str());
+    return false;
+  }
+  
+  value = value.substr(first, last - first + 1);
+  ESP_LOGD(TAG, "Trimmed value for '%s': '%s'", key.c_str(), value.c_str());
+  
+  char* endptr = nullptr;
+  result = std::strtof(value.c_str(), &endptr);
+  if (endptr == value.c_str() || *endptr != '\0') {
+    ESP_LOGE(TAG, "Failed to convert '%s' to float", value.c_str());
+    return false;
+  }
+  
+  ESP_LOGD(TAG, "Successfully extracted %s = %.2f", key.c_str(), result);
+  return true;
+}
+
+}  // namespace before_tokenizer
+
+// What reading the state reply cost before the tokenizer: one find/substr/strtof
+// pass per key
+static void BM_ParseStateReplyByKey(benchmark::State &state) {
+  for (auto _ : state) {
+    float level = 0.0f;
+    float countdown = 0.0f;
+    bool muted = false;
+    before_tokenizer::extract_json_number(STATE_REPLY, "level", level);
+    before_tokenizer::check_json_boolean(STATE_REPLY, "mute", muted);
+    before_tokenizer::extract_json_number(STATE_REPLY, "countdown", countdown);
+    benchmark::DoNotOptimize(level);
+    benchmark::DoNotOptimize(muted);
+    benchmark::DoNotOptimize(countdown);
+  }
+  state.SetBytesProcessed(state.iterations() * (sizeof(STATE_REPLY) - 1));
+}
+BENCHMARK(BM_ParseStateReplyByKey);
+
+static void BM_QueryLongReply(benchmark::State &state) {
+  std::string reply = eq_reply();
+  for (auto _ : state) {
+    float level = 0.0f;
+    benchmark::DoNotOptimize(ssc_query(reply, "/audio/out/level", level));
+    benchmark::DoNotOptimize(level);
+  }
+  state.SetBytesProcessed(state.iterations() * reply.size());
+}
+BENCHMARK(BM_QueryLongReply);
+
+static void BM_ExtractXid(benchmark::State &state) {
+  for (auto _ : state) {
+    uint32_t xid = 0;
+    benchmark::DoNotOptimize(network::extract_xid(STATE_REPLY, xid));
+    benchmark::DoNotOptimize(xid);
+  }
+}
+BENCHMARK(BM_ExtractXid);
+
+static constexpr auto LEVEL = ssc_path("/audio/out/level");
+static constexpr auto TIMETAG = ssc_path("/osc/timetag");
+
+static void BM_BuildLevelCommand(benchmark::State &state) {
+  float level = 60.0f;
+  for (auto _ : state) {
+    SscMessage<SSC_COMMAND_SIZE> message;
+    message.begin().set(LEVEL, level).end();
+    benchmark::DoNotOptimize(message.data());
+    level = level < 80.0f ? level + 0.5f : 60.0f;
+  }
+}
+BENCHMARK(BM_BuildLevelCommand);
+
+static void BM_BuildTimetaggedLevelCommand(benchmark::State &state) {
+  float level = 60.0f;
+  for (auto _ : state) {
+    SscMessage<SSC_COMMAND_SIZE> message;
+    message.begin().set(TIMETAG, 0.015f, 3).set(LEVEL, level).end();
+    benchmark::DoNotOptimize(message.data());
+    level = level < 80.0f ? level + 0.5f : 60.0f;
+  }
+}
+BENCHMARK(BM_BuildTimetaggedLevelCommand);
+
+// What the level command cost before the builders
+static void BM_ConcatenateLevelCommand(benchmark::State &state) {
+  float level = 60.0f;
+  for (auto _ : state) {
+    std::string command = "{\"audio\":{\"out\":{\"level\":" + std::to_string(level) + "}}}";
+    benchmark::DoNotOptimize(command.data());
+    level = level < 80.0f ? level + 0.5f : 60.0f;
+  }
+}
+BENCHMARK(BM_ConcatenateLevelCommand);
+
+// Tagging reuses the payload, as a coalesced write does
+static void BM_TagWithXid(benchmark::State &state) {
+  SscMessage<SSC_COMMAND_SIZE> message;
+  message.begin().set(LEVEL, 62.5f).end();
+  std::string payload;
+  uint32_t xid = 1;
+  for (auto _ : state) {
+    network::tag_with_xid(message, xid++, payload);
+    payload += "\r\n";
+    benchmark::DoNotOptimize(payload.data());
+  }
+}
+BENCHMARK(BM_TagWithXid);
@@ -0,0 +1,122 @@
+// Runs emulated SSC speakers until interrupted, see SpeakerEmulator.
+//
+//   ssc_emulator --speakers 2 --port 4500 --latency 5 --jitter 3 --loss 0.01
+//
+// The speakers listen on consecutive ports from --port (45 needs root). Point
+// the controller's roster at them as "[::1]:4500", "[::1]:4501", ...
+
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <vector>
+#include "platform.h"
+#include "ssc_emulator.h"
+
+using esphome::vol_ctrl::emulator::EmulatorConfig;
+using esphome::vol_ctrl::emulator::EmulatorStats;
+using esphome::vol_ctrl::emulator::SpeakerEmulator;
+
+static volatile sig_atomic_t interrupted = 0;
+
+static void on_signal(int) { interrupted = 1; }
+
+static void usage() {
+  fprintf(stderr,
+          "Usage: ssc_emulator [options]\n"
+          "  --address ADDR         listen address (default ::)\n"
+          "  --port N               first port (default 45, 0 picks free ones)\n"
+          "  --speakers N           number of speakers (default 1)\n"
+          "  --latency MS           request handling delay (default 0)\n"
+          "  --jitter MS            uniform extra delay up to MS (default 0)\n"
+          "  --loss P               packet loss probability 0..1 (default 0)\n"
+          "  --standby-after S      auto standby countdown (default 5400)\n"
+          "  --standby-offline      drop off the network in standby\n"
+          "  --wake-after MS        leave standby after MS (default: never)\n"
+          "  --no-xid               do not reflect /osc/xid\n"
+          "  --no-timetag           do not support /osc/timetag\n"
+          "  --seed N               random seed (default 1)\n"
+          "  -v, -vv                log requests\n");
+}
+
+int main(int argc, char **argv) {
+  EmulatorConfig config;
+  int count = 1;
+  for (int i = 1; i < argc; i++) {
+    const char *arg = argv[i];
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool takes_value = true;
+    if (strcmp(arg, "--address") == 0 && value != nullptr) {
+      config.address = value;
+    } else if (strcmp(arg, "--port") == 0 && value != nullptr) {
+      config.port = static_cast<uint16_t>(atoi(value));
+    } else if (strcmp(arg, "--speakers") == 0 && value != nullptr) {
+      count = atoi(value);
+    } else if (strcmp(arg, "--latency") == 0 && value != nullptr) {
+      config.latency_ms = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(arg, "--jitter") == 0 && value != nullptr) {
+      config.jitter_ms = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(arg, "--loss") == 0 && value != nullptr) {
+      config.loss = static_cast<float>(atof(value));
+    } else if (strcmp(arg, "--standby-after") == 0 && value != nullptr) {
+      config.standby_after_s = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(arg, "--wake-after") == 0 && value != nullptr) {
+      config.wake_after_ms = static_cast<uint32_t>(atoi(value));
+    } else if (strcmp(arg, "--seed") == 0 && value != nullptr) {
+      config.seed = static_cast<uint32_t>(atoi(value));
+    } else {
+      takes_value = false;
+      if (strcmp(arg, "--standby-offline") == 0) {
+        config.standby_offline = true;
+      } else if (strcmp(arg, "--no-xid") == 0) {
+        config.reflect_xid = false;
+      } else if (strcmp(arg, "--no-timetag") == 0) {
+        config.timetag = false;
+      } else if (strcmp(arg, "-v") == 0) {
+        esphome::host_log_level() = 4;
+      } else if (strcmp(arg, "-vv") == 0) {
+        esphome::host_log_level() = 5;
+      } else {
+        usage();
+        return 2;
+      }
+    }
+    if (takes_value) {
+      i++;
+    }
+  }
+  if (count < 1) {
+    usage();
+    return 2;
+  }
+
+  std::vector<std::unique_ptr<SpeakerEmulator>> speakers;
+  for (int i = 0; i < count; i++) {
+    EmulatorConfig speaker_config = config;
+    speaker_config.port = config.port == 0 ? 0 : static_cast<uint16_t>(config.port + i);
+    speaker_config.seed = config.seed + i;
+    speakers.emplace_back(new SpeakerEmulator(speaker_config));
+    if (!speakers.back()->start()) {
+      return 1;
+    }
+    printf("speaker %d: %s port %u\n", i, speakers.back()->loopback_address().c_str(), speakers.back()->port());
+  }
+  fflush(stdout);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  while (!interrupted) {
+    pause();
+  }
+
+  for (size_t i = 0; i < speakers.size(); i++) {
+    EmulatorStats stats = speakers[i]->stats();
+    printf("speaker %zu: %u connections, %u requests (%u UDP, %u dropped, %u retransmitted), %u writes, "
+           "%u notifications, %u errors, level %.1f\n",
+           i, stats.connections, stats.requests, stats.datagrams, stats.dropped, stats.retransmits, stats.writes,
+           stats.notifications, stats.errors, speakers[i]->level());
+    speakers[i]->stop();
+  }
+  return 0;
+}
@@ -0,0 +1,852 @@
+#include "ssc_emulator.h"
+#include "platform.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace esphome {
+namespace vol_ctrl {
+namespace emulator {
+
+static const char *const TAG = "ssc_emulator";
+
+// Longest message a client may send before its session is reset
+static const size_t MAX_MESSAGE = 65536;
+// Values below one year are relative (spec 5.1.12)
+static const float TIMETAG_MAX_RELATIVE_S = 31536000.0f;
+
+static inline bool deadline_passed(uint32_t now, uint32_t deadline) { return static_cast<int32_t>(now - deadline) >= 0; }
+
+static void set_non_blocking(int sock) {
+  int flags = fcntl(sock, F_GETFL, 0);
+  fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+}
+
+static void append_number(std::string &out, float value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%g", value);
+  out += buffer;
+}
+
+// True if a subscription to subscribed covers a change of changed
+static bool covers(const std::string &subscribed, const std::string &changed) {
+  return changed.compare(0, subscribed.size(), subscribed) == 0 &&
+         (changed.size() == subscribed.size() || changed[subscribed.size()] == '/');
+}
+
+SpeakerEmulator::SpeakerEmulator(const EmulatorConfig &config)
+    : config_(config), random_(config.seed), product_(config.product), serial_(config.serial) {
+  for (size_t band = 0; band < EQ_BANDS; band++) {
+    // Third octaves from 25 Hz, a neutral starting point
+    float frequency = 25.0f * std::pow(2.0f, band / 3.0f);
+    for (Equalizer *eq : {&this->eq2_, &this->eq3_}) {
+      eq->gain[band] = 0.0f;
+      eq->boost[band] = 0.0f;
+      eq->frequency[band] = std::round(frequency);
+      eq->q[band] = 0.7f;
+    }
+  }
+  this->eq2_.desc = "user EQ";
+  this->eq3_.desc = "calibration EQ";
+  this->countdown_ = static_cast<float>(config.standby_after_s);
+
+  auto number = [this](const char *path, float *value, bool writable) {
+    this->addresses_.push_back({path, Kind::NUMBER, writable, value, nullptr, nullptr, 1});
+  };
+  auto boolean = [this](const char *path, bool *value) {
+    this->addresses_.push_back({path, Kind::BOOLEAN, true, nullptr, value, nullptr, 0});
+  };
+  auto string = [this](const std::string &path, std::string *value) {
+    this->addresses_.push_back({path, Kind::STRING, false, nullptr, nullptr, value, 0});
+  };
+  auto numbers = [this](const std::string &path, float *values) {
+    this->addresses_.push_back({path, Kind::NUMBERS, true, values, nullptr, nullptr, EQ_BANDS});
+  };
+  number("/audio/out/level", &this->level_, true);
+  boolean("/audio/out/mute", &this->mute_);
+  number("/device/standby/countdown", &this->countdown_, false);
+  boolean("/device/standby/enabled", &this->standby_enabled_);
+  string("/device/identity/product", &this->product_);
+  string("/device/identity/serial", &this->serial_);
+  for (auto eq : {std::make_pair("/audio/out/eq2", &this->eq2_), std::make_pair("/audio/out/eq3", &this->eq3_)}) {
+    std::string base = eq.first;
+    numbers(base + "/gain", eq.second->gain);
+    numbers(base + "/boost", eq.second->boost);
+    numbers(base + "/frequency", eq.second->frequency);
+    numbers(base + "/q", eq.second->q);
+    string(base + "/desc", &eq.second->desc);
+  }
+}
+
+std::string SpeakerEmulator::loopback_address() const { return "[::1]:" + std::to_string(this->port_); }
+
+bool SpeakerEmulator::start() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (this->running_) {
+    return true;
+  }
+  if (pipe(this->wake_pipe_) != 0) {
+    return false;
+  }
+  set_non_blocking(this->wake_pipe_[0]);
+  if (!this->open_sockets_()) {
+    ::close(this->wake_pipe_[0]);
+    ::close(this->wake_pipe_[1]);
+    return false;
+  }
+  if (this->serial_.empty()) {
+    this->serial_ = "EMU" + std::to_string(this->port_);
+  }
+  this->last_activity_ = millis();
+  this->running_ = true;
+  if (this->config_.threaded) {
+    this->thread_ = std::thread([this]() { this->run_(); });
+  }
+  return true;
+}
+
+void SpeakerEmulator::stop() {
+  if (!this->running_) {
+    return;
+  }
+  this->running_ = false;
+  char byte = 0;
+  (void) !write(this->wake_pipe_[1], &byte, 1);
+  if (this->thread_.joinable()) {
+    this->thread_.join();
+  }
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->drop_clients_();
+  this->close_sockets_();
+  ::close(this->wake_pipe_[0]);
+  ::close(this->wake_pipe_[1]);
+}
+
+float SpeakerEmulator::level() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->level_;
+}
+
+bool SpeakerEmulator::muted() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->mute_;
+}
+
+bool SpeakerEmulator::in_standby() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->standby_;
+}
+
+uint32_t SpeakerEmulator::standby_countdown() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return static_cast<uint32_t>(this->countdown_);
+}
+
+EmulatorStats SpeakerEmulator::stats() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  return this->stats_;
+}
+
+void SpeakerEmulator::wake() {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->activity_(millis());
+  if (!this->online_ && this->open_sockets_()) {
+    this->online_ = true;
+  }
+  char byte = 0;
+  (void) !write(this->wake_pipe_[1], &byte, 1);
+}
+
+void SpeakerEmulator::set_online(bool online) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  if (online == this->online_) {
+    return;
+  }
+  if (online) {
+    this->online_ = this->open_sockets_();
+  } else {
+    this->drop_clients_();
+    this->close_sockets_();
+    this->pending_.clear();
+    this->online_ = false;
+  }
+  // The thread may be waiting on the sockets that just changed
+  char byte = 0;
+  (void) !write(this->wake_pipe_[1], &byte, 1);
+}
+
+void SpeakerEmulator::set_answering(bool answering) {
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  this->answering_ = answering;
+  if (!answering) {
+    this->pending_.clear();
+  }
+}
+
+bool SpeakerEmulator::open_sockets_() {
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_port = htons(this->port_ != 0 ? this->port_ : this->config_.port);
+  if (inet_pton(AF_INET6, this->config_.address.c_str(), &addr.sin6_addr) != 1) {
+    ESP_LOGE(TAG, "Invalid listen address %s", this->config_.address.c_str());
+    return false;
+  }
+
+  this->listener_ = socket(AF_INET6, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(this->listener_, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  if (bind(this->listener_, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(this->listener_, 16) != 0) {
+    ESP_LOGE(TAG, "Cannot listen on [%s]:%u: %s", this->config_.address.c_str(), ntohs(addr.sin6_port),
+             strerror(errno));
+    this->close_sockets_();
+    return false;
+  }
+  set_non_blocking(this->listener_);
+  socklen_t len = sizeof(addr);
+  getsockname(this->listener_, (struct sockaddr *) &addr, &len);
+  this->port_ = ntohs(addr.sin6_port);
+
+  this->udp_ = socket(AF_INET6, SOCK_DGRAM, 0);
+  if (bind(this->udp_, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+    ESP_LOGE(TAG, "Cannot bind UDP port %u: %s", this->port_, strerror(errno));
+    this->close_sockets_();
+    return false;
+  }
+  set_non_blocking(this->udp_);
+  return true;
+}
+
+void SpeakerEmulator::close_sockets_() {
+  if (this->listener_ >= 0) {
+    ::close(this->listener_);
+    this->listener_ = -1;
+  }
+  if (this->udp_ >= 0) {
+    ::close(this->udp_);
+    this->udp_ = -1;
+  }
+}
+
+void SpeakerEmulator::drop_clients_() {
+  for (Client &client : this->clients_) {
+    if (client.sock >= 0) {
+      ::close(client.sock);
+    }
+  }
+  this->clients_.clear();
+}
+
+void SpeakerEmulator::step() {
+  if (this->running_) {
+    this->service_(0);
+  }
+}
+
+void SpeakerEmulator::run_() {
+  while (this->running_) {
+    this->service_(10);  // Standby and subscription timers need no finer grain
+  }
+}
+
+// Waits up to max_wait_ms for something to do, then does everything that is due
+void SpeakerEmulator::service_(uint32_t max_wait_ms) {
+  fd_set read_fds;
+  FD_ZERO(&read_fds);
+  int max_fd = this->wake_pipe_[0];
+  FD_SET(this->wake_pipe_[0], &read_fds);
+  uint32_t wait_ms = max_wait_ms;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex_);
+    for (int sock : {this->listener_, this->udp_}) {
+      if (sock >= 0) {
+        FD_SET(sock, &read_fds);
+        max_fd = std::max(max_fd, sock);
+      }
+    }
+    for (const Client &client : this->clients_) {
+      FD_SET(client.sock, &read_fds);
+      max_fd = std::max(max_fd, client.sock);
+    }
+    if (!this->pending_.empty()) {
+      int32_t until = static_cast<int32_t>(this->pending_.front().due - millis());
+      wait_ms = until <= 0 ? 0 : std::min<uint32_t>(wait_ms, until);
+    }
+  }
+  struct timeval timeout = {0, static_cast<suseconds_t>(wait_ms * 1000)};
+  int ready = select(max_fd + 1, &read_fds, nullptr, nullptr, &timeout);
+
+  std::lock_guard<std::mutex> lock(this->mutex_);
+  uint32_t now = millis();
+  if (ready > 0) {
+    char drain[16];
+    if (FD_ISSET(this->wake_pipe_[0], &read_fds)) {
+      while (read(this->wake_pipe_[0], drain, sizeof(drain)) > 0) {
+      }
+    }
+    // A socket may have been closed by set_online() while select() waited
+    if (this->listener_ >= 0 && FD_ISSET(this->listener_, &read_fds)) {
+      this->accept_();
+    }
+    if (this->udp_ >= 0 && FD_ISSET(this->udp_, &read_fds)) {
+      this->read_datagrams_();
+    }
+    for (Client &client : this->clients_) {
+      if (client.sock >= 0 && FD_ISSET(client.sock, &read_fds)) {
+        this->read_client_(client);
+      }
+    }
+  }
+  this->handle_due_(now);
+  this->expire_subscriptions_(now);
+  this->update_standby_(now);
+  this->clients_.erase(std::remove_if(this->clients_.begin(), this->clients_.end(),
+                                      [](const Client &client) { return client.sock < 0; }),
+                       this->clients_.end());
+}
+
+void SpeakerEmulator::accept_() {
+  int sock;
+  while ((sock = accept(this->listener_, nullptr, nullptr)) >= 0) {
+    if (this->clients_.size() >= this->config_.max_clients) {
+      ESP_LOGW(TAG, "Port %u: too many clients, refusing one", this->port_);
+      ::close(sock);
+      continue;
+    }
+    set_non_blocking(sock);
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    Client client;
+    client.sock = sock;
+    client.id = this->next_client_id_++;
+    this->clients_.push_back(std::move(client));
+    this->stats_.connections++;
+    ESP_LOGD(TAG, "Port %u: client %u connected", this->port_, this->clients_.back().id);
+  }
+}
+
+void SpeakerEmulator::read_client_(Client &client) {
+  char buffer[2048];
+  uint32_t now = millis();
+  while (true) {
+    ssize_t received = recv(client.sock, buffer, sizeof(buffer), 0);
+    if (received > 0) {
+      client.rx.append(buffer, received);
+      continue;
+    }
+    if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      break;
+    }
+    ESP_LOGD(TAG, "Port %u: client %u disconnected", this->port_, client.id);
+    ::close(client.sock);
+    client.sock = -1;
+    return;
+  }
+  size_t end;
+  while ((end = client.rx.find('\n')) != std::string::npos) {
+    std::string message = client.rx.substr(0, end);
+    client.rx.erase(0, end + 1);
+    if (!message.empty() && message.back() == '\r') {
+      message.pop_back();
+    }
+    if (!message.empty()) {
+      this->queue_request_(client.id, nullptr, std::move(message), now);
+    }
+  }
+  if (client.rx.size() > MAX_MESSAGE) {
+    ESP_LOGW(TAG, "Port %u: client %u sent an oversized message, resetting", this->port_, client.id);
+    ::close(client.sock);
+    client.sock = -1;
+  }
+}
+
+void SpeakerEmulator::read_datagrams_() {
+  char buffer[2048];
+  uint32_t now = millis();
+  while (true) {
+    struct sockaddr_in6 source;
+    socklen_t len = sizeof(source);
+    ssize_t received = recvfrom(this->udp_, buffer, sizeof(buffer), 0, (struct sockaddr *) &source, &len);
+    if (received <= 0) {
+      return;
+    }
+    std::string message(buffer, received);
+    while (!message.empty() && (message.back() == '\n' || message.back() == '\r')) {
+      message.pop_back();
+    }
+    this->stats_.datagrams++;
+    this->queue_request_(0, &source, std::move(message), now);
+  }
+}
+
+uint32_t SpeakerEmulator::delay_(bool datagram, bool &lost) {
+  uint32_t delay = this->config_.latency_ms;
+  if (this->config_.jitter_ms > 0) {
+    delay += std::uniform_int_distribution<uint32_t>(0, this->config_.jitter_ms)(this->random_);
+  }
+  lost = false;
+  if (this->config_.loss > 0.0f && std::uniform_real_distribution<float>(0.0f, 1.0f)(this->random_) < this->config_.loss) {
+    if (datagram) {
+      lost = true;
+    } else {
+      delay += this->config_.retransmit_ms;
+      this->stats_.retransmits++;
+    }
+  }
+  return delay;
+}
+
+void SpeakerEmulator::queue_request_(uint32_t client, const struct sockaddr_in6 *source, std::string message,
+                                     uint32_t now) {
+  if (!this->answering_) {
+    return;
+  }
+  bool lost;
+  uint32_t delay = this->delay_(source != nullptr, lost);
+  if (lost) {
+    this->stats_.dropped++;
+    return;
+  }
+  float timetag = 0.0f;
+  if (this->config_.timetag && ssc_query(message, "/osc/timetag", timetag) && timetag > 0.0f &&
+      timetag < TIMETAG_MAX_RELATIVE_S) {
+    delay += static_cast<uint32_t>(timetag * 1000.0f);
+  }
+
+  Pending pending;
+  pending.due = now + delay;
+  pending.client = client;
+  if (source != nullptr) {
+    pending.source = *source;
+  }
+  pending.message = std::move(message);
+  if (client != 0) {
+    for (Client &session : this->clients_) {
+      if (session.id == client) {
+        // TCP delivers in order: a reply cannot overtake the one before it
+        if (static_cast<int32_t>(session.last_due - pending.due) > 0) {
+          pending.due = session.last_due;
+        }
+        session.last_due = pending.due;
+      }
+    }
+  }
+  auto position = std::upper_bound(this->pending_.begin(), this->pending_.end(), pending.due,
+                                   [](uint32_t due, const Pending &other) { return static_cast<int32_t>(due - other.due) < 0; });
+  this->pending_.insert(position, std::move(pending));
+}
+
+void SpeakerEmulator::handle_due_(uint32_t now) {
+  while (!this->pending_.empty() && deadline_passed(now, this->pending_.front().due)) {
+    Pending pending = std::move(this->pending_.front());
+    this->pending_.pop_front();
+    if (pending.client == 0) {
+      std::string reply = this->handle_(pending.message, nullptr, now);
+      sendto(this->udp_, reply.data(), reply.size(), 0, (struct sockaddr *) &pending.source, sizeof(pending.source));
+      continue;
+    }
+    for (Client &client : this->clients_) {
+      if (client.id == pending.client && client.sock >= 0) {
+        this->send_(client, this->handle_(pending.message, &client, now) + "\r\n");
+        break;
+      }
+    }
+  }
+}
+
+std::string SpeakerEmulator::handle_(const std::string &message, Client *client, uint32_t now) {
+  this->stats_.requests++;
+  ESP_LOGV(TAG, "Port %u: request %s", this->port_, message.c_str());
+  JsonTokenizer tokens(message);
+  Outcome outcome;
+  std::string path;
+  std::string reply;
+  if (!this->answer_(tokens, tokens.next(), path, Mode::NORMAL, outcome, reply) ||
+      tokens.next() != JsonToken::END) {
+    this->stats_.errors++;
+    return "{\"osc\":{\"error\":[400,{\"desc\":\"malformed message\"}]}}";
+  }
+  if (outcome.subscribe && client != nullptr) {
+    Subscription &subscription = client->subscription;
+    subscription.paths = std::move(outcome.subscribed);
+    subscription.expires = now + (outcome.lifetime_s != 0 ? outcome.lifetime_s : 10) * 1000;
+    subscription.active = true;
+  }
+  if (!outcome.changed.empty()) {
+    this->stats_.writes += outcome.changed.size();
+    this->stats_.last_write_us = micros();
+    if (this->level_listener_) {
+      for (const std::string &changed : outcome.changed) {
+        if (changed == "/audio/out/level") {
+          this->level_listener_(this->level_);
+        }
+      }
+    }
+    for (const std::string &changed : outcome.changed) {
+      if (changed == "/audio/out/level" || changed == "/audio/out/mute") {
+        this->activity_(now);
+        break;
+      }
+    }
+    this->notify_(outcome.changed, client != nullptr ? client->id : 0);
+  }
+  if (outcome.error) {
+    this->stats_.errors++;
+    return "{\"osc\":{\"error\":[" + reply + "]}}";
+  }
+  return reply;
+}
+
+// Writes the answer to the value that starts with token at path, in the shape
+// of the request. Returns false if the request is malformed.
+bool SpeakerEmulator::answer_(JsonTokenizer &tokens, JsonToken token, std::string &path, Mode mode,
+                              Outcome &outcome, std::string &out) {
+  switch (token) {
+    case JsonToken::OBJECT_BEGIN: {
+      out += '{';
+      bool first = true;
+      while (true) {
+        JsonToken member = tokens.next();
+        if (member == JsonToken::OBJECT_END) {
+          break;
+        }
+        if (member != JsonToken::KEY) {
+          return false;
+        }
+        Slice key = tokens.text();
+        size_t length = path.size();
+        path += '/';
+        path.append(key.data(), key.size());
+
+        Mode child = mode;
+        if (mode == Mode::NORMAL && path == "/osc/state/subscribe") {
+          child = Mode::SUBSCRIBE_LIST;
+        } else if (mode == Mode::SUBSCRIBE && path == "/#") {
+          child = Mode::ECHO;
+        }
+        // Old firmware leaves the xid out of its reply
+        bool skip = mode == Mode::NORMAL && path == "/osc/xid" && !this->config_.reflect_xid;
+        std::string ignored;
+        if (!skip) {
+          if (!first) {
+            out += ',';
+          }
+          first = false;
+          out += '"';
+          out.append(key.data(), key.size());
+          out += "\":";
+        }
+        if (!this->answer_(tokens, tokens.next(), path, child, outcome, skip ? ignored : out)) {
+          return false;
+        }
+        path.resize(length);
+      }
+      out += '}';
+      return true;
+    }
+
+    case JsonToken::ARRAY_BEGIN: {
+      if (mode == Mode::NORMAL) {
+        return this->answer_array_(tokens, path, outcome, out);
+      }
+      // Subscription requests and echoed values: same shape, element by element
+      Mode element_mode = mode == Mode::SUBSCRIBE_LIST ? Mode::SUBSCRIBE : mode;
+      if (mode == Mode::SUBSCRIBE_LIST) {
+        outcome.subscribe = true;
+      }
+      out += '[';
+      bool first = true;
+      while (true) {
+        JsonToken element = tokens.next();
+        if (element == JsonToken::ARRAY_END) {
+          break;
+        }
+        if (!first) {
+          out += ',';
+        }
+        first = false;
+        // Subscribed addresses start from the root again
+        std::string element_path = mode == Mode::SUBSCRIBE_LIST ? std::string() : path;
+        if (!this->answer_(tokens, element, element_path, element_mode, outcome, out)) {
+          return false;
+        }
+      }
+      out += ']';
+      return true;
+    }
+
+    case JsonToken::NUMBER:
+    case JsonToken::BOOLEAN:
+    case JsonToken::STRING:
+    case JsonToken::NULL_VALUE:
+      break;
+
+    default:
+      return false;
+  }
+
+  // A leaf value
+  if (mode == Mode::ECHO || (mode == Mode::NORMAL && (path == "/osc/xid" || path == "/osc/ping" ||
+                                                      path == "/osc/timetag"))) {
+    if (mode == Mode::ECHO && path == "/#/lifetime" && token == JsonToken::NUMBER) {
+      outcome.lifetime_s = static_cast<uint32_t>(tokens.number());
+    }
+    if (token == JsonToken::STRING) {
+      out += '"';
+      out.append(tokens.text().data(), tokens.text().size());
+      out += '"';
+    } else {
+      out.append(tokens.text().data(), tokens.text().size());
+    }
+    return true;
+  }
+  if (mode == Mode::NORMAL && path == "/osc/feature/timetag") {
+    out += this->config_.timetag ? "true" : "false";
+    return true;
+  }
+  if (mode == Mode::SUBSCRIBE_LIST) {
+    this->write_error_(400, "subscribe expects a list", outcome, out);
+    return true;
+  }
+
+  Address *address = this->find_address_(path);
+  if (address == nullptr) {
+    this->write_error_(404, "address not found", outcome, out);
+    return true;
+  }
+  if (mode == Mode::SUBSCRIBE || token == JsonToken::NULL_VALUE) {
+    if (mode == Mode::SUBSCRIBE) {
+      outcome.subscribed.push_back(path);
+    }
+    this->write_value_(*address, out);
+    return true;
+  }
+  if (!address->writable) {
+    this->write_error_(403, "address is read only", outcome, out);
+    return true;
+  }
+  bool changed = false;
+  if (address->kind == Kind::NUMBER && token == JsonToken::NUMBER) {
+    changed = *address->number != tokens.number();
+    *address->number = tokens.number();
+  } else if (address->kind == Kind::BOOLEAN && token == JsonToken::BOOLEAN) {
+    changed = *address->boolean != tokens.boolean();
+    *address->boolean = tokens.boolean();
+  } else {
+    this->write_error_(400, "wrong type", outcome, out);
+    return true;
+  }
+  if (changed) {
+    outcome.changed.push_back(path);
+  }
+  this->write_value_(*address, out);
+  return true;
+}
+
+// An array at path: nulls ask for the current values, numbers set them
+bool SpeakerEmulator::answer_array_(JsonTokenizer &tokens, std::string &path, Outcome &outcome, std::string &out) {
+  Address *address = this->find_address_(path);
+  std::vector<float> values;
+  std::vector<bool> given;
+  bool typed = true;
+  while (true) {
+    JsonToken element = tokens.next();
+    if (element == JsonToken::ARRAY_END) {
+      break;
+    }
+    if (element == JsonToken::NUMBER) {
+      values.push_back(tokens.number());
+      given.push_back(true);
+    } else if (element == JsonToken::NULL_VALUE) {
+      values.push_back(0.0f);
+      given.push_back(false);
+    } else if (element == JsonToken::OBJECT_BEGIN || element == JsonToken::ARRAY_BEGIN) {
+      std::string ignored;
+      if (!this->answer_(tokens, element, path, Mode::ECHO, outcome, ignored)) {
+        return false;
+      }
+      typed = false;
+    } else if (element == JsonToken::STRING || element == JsonToken::BOOLEAN) {
+      typed = false;
+    } else {
+      return false;
+    }
+  }
+  if (address == nullptr) {
+    this->write_error_(404, "address not found", outcome, out);
+    return true;
+  }
+  if (address->kind != Kind::NUMBERS || !typed || values.size() > address->count) {
+    this->write_error_(400, "wrong type", outcome, out);
+    return true;
+  }
+  bool changed = false;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (given[i] && address->number[i] != values[i]) {
+      address->number[i] = values[i];
+      changed = true;
+    }
+  }
+  if (changed) {
+    outcome.changed.push_back(path);
+  }
+  this->write_value_(*address, out);
+  return true;
+}
+
+void SpeakerEmulator::write_value_(const Address &address, std::string &out) const {
+  switch (address.kind) {
+    case Kind::NUMBER:
+      append_number(out, *address.number);
+      break;
+    case Kind::BOOLEAN:
+      out += *address.boolean ? "true" : "false";
+      break;
+    case Kind::STRING:
+      out += '"';
+      out += *address.string;
+      out += '"';
+      break;
+    case Kind::NUMBERS:
+      out += '[';
+      for (size_t i = 0; i < address.count; i++) {
+        if (i > 0) {
+          out += ',';
+        }
+        append_number(out, address.number[i]);
+      }
+      out += ']';
+      break;
+  }
+}
+
+void SpeakerEmulator::write_error_(int status, const char *desc, Outcome &outcome, std::string &out) {
+  outcome.error = true;
+  out += '[';
+  out += std::to_string(status);
+  out += ",{\"desc\":\"";
+  out += desc;
+  out += "\"}]";
+}
+
+SpeakerEmulator::Address *SpeakerEmulator::find_address_(const std::string &path) {
+  for (Address &address : this->addresses_) {
+    if (address.path == path) {
+      return &address;
+    }
+  }
+  return nullptr;
+}
+
+// One message per changed address, to every other client that subscribed to it
+void SpeakerEmulator::notify_(const std::vector<std::string> &changed, uint32_t writer) {
+  for (const std::string &path : changed) {
+    Address *address = this->find_address_(path);
+    if (address == nullptr) {
+      continue;
+    }
+    // "/audio/out/level" -> {"audio":{"out":{"level":<value>}}}
+    std::string message;
+    size_t depth = 0;
+    size_t pos = 0;
+    while (pos < path.size()) {
+      size_t end = path.find('/', pos + 1);
+      if (end == std::string::npos) {
+        end = path.size();
+      }
+      message += "{\"" + path.substr(pos + 1, end - pos - 1) + "\":";
+      depth++;
+      pos = end;
+    }
+    this->write_value_(*address, message);
+    message.append(depth, '}');
+    message += "\r\n";
+
+    for (Client &client : this->clients_) {
+      if (client.id == writer || client.sock < 0 || !client.subscription.active) {
+        continue;
+      }
+      for (const std::string &subscribed : client.subscription.paths) {
+        if (covers(subscribed, path)) {
+          this->send_(client, message);
+          this->stats_.notifications++;
+          break;
+        }
+      }
+    }
+  }
+}
+
+void SpeakerEmulator::expire_subscriptions_(uint32_t now) {
+  for (Client &client : this->clients_) {
+    Subscription &subscription = client.subscription;
+    if (client.sock < 0 || !subscription.active || !deadline_passed(now, subscription.expires)) {
+      continue;
+    }
+    subscription.active = false;
+    this->send_(client, "{\"osc\":{\"error\":[{\"osc\":{\"state\":{\"subscribe\":[310,{\"desc\":\"subscription "
+                        "terminates\"}]}}}]}}\r\n");
+    this->stats_.notifications++;
+  }
+}
+
+void SpeakerEmulator::activity_(uint32_t now) {
+  this->last_activity_ = now;
+  this->standby_ = false;
+  this->countdown_ = static_cast<float>(this->config_.standby_after_s);
+}
+
+void SpeakerEmulator::update_standby_(uint32_t now) {
+  if (this->standby_) {
+    if (!this->online_ && this->config_.wake_after_ms != 0 &&
+        now - this->standby_since_ >= this->config_.wake_after_ms && this->open_sockets_()) {
+      ESP_LOGI(TAG, "Port %u: waking up", this->port_);
+      this->online_ = true;
+      this->activity_(now);
+    }
+    return;
+  }
+  if (!this->standby_enabled_) {
+    this->last_activity_ = now;
+    return;
+  }
+  uint32_t elapsed_s = (now - this->last_activity_) / 1000;
+  uint32_t after_s = this->config_.standby_after_s;
+  this->countdown_ = static_cast<float>(elapsed_s < after_s ? after_s - elapsed_s : 0);
+  if (this->countdown_ > 0.0f) {
+    return;
+  }
+  ESP_LOGI(TAG, "Port %u: going to standby", this->port_);
+  this->standby_ = true;
+  this->standby_since_ = now;
+  this->notify_({"/device/standby/countdown"}, 0);
+  if (this->config_.standby_offline) {
+    this->drop_clients_();
+    this->close_sockets_();
+    this->pending_.clear();
+    this->online_ = false;
+  }
+}
+
+// Small messages on a local socket: waiting a little for room is fine
+void SpeakerEmulator::send_(Client &client, const std::string &message) {
+  size_t sent = 0;
+  uint32_t start = millis();
+  while (sent < message.size() && millis() - start < 100) {
+    ssize_t result = send(client.sock, message.data() + sent, message.size() - sent, MSG_NOSIGNAL);
+    if (result > 0) {
+      sent += result;
+    } else if (result < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+      break;
+    }
+  }
+  if (sent < message.size()) {
+    ESP_LOGW(TAG, "Port %u: cannot write to client %u, resetting", this->port_, client.id);
+    ::close(client.sock);
+    client.sock = -1;
+  }
+}
+
+}  // namespace emulator
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <netinet/in.h>
+#include "ssc_json.h"
+
+namespace esphome {
+namespace vol_ctrl {
+namespace emulator {
+
+struct EmulatorConfig {
+  std::string address = "::";  // Where to listen, "::1" for loopback only
+  uint16_t port = 45;          // TCP and UDP, 0 picks a free one (see SpeakerEmulator::port())
+  std::string product = "KH 150";
+  std::string serial;  // Default: derived from the port
+
+  // Every request is handled this long after it arrives and the reply goes
+  // out at once, so it stands for the speaker's turnaround plus the network
+  // round trip. Jitter adds a uniform 0..jitter_ms on top; replies on one TCP
+  // session stay in order.
+  uint32_t latency_ms = 0;
+  uint32_t jitter_ms = 0;
+  // Chance that a packet is lost. UDP requests are dropped; on TCP the
+  // segment is retransmitted, which costs retransmit_ms.
+  float loss = 0.0f;
+  uint32_t retransmit_ms = 200;  // Linux' minimum RTO
+
+  // Auto standby: the countdown starts at standby_after_s and restarts with
+  // every level or mute write. At 0 the speaker goes to standby; a standby
+  // speaker keeps answering unless standby_offline is set, then it drops
+  // off the network until wake() or wake_after_ms.
+  uint32_t standby_after_s = 5400;
+  bool standby_offline = false;
+  uint32_t wake_after_ms = 0;  // 0: only wake() brings it back
+
+  bool reflect_xid = true;  // Off: old firmware that ignores /osc/xid
+  bool timetag = true;      // Supports /osc/timetag
+  uint32_t max_clients = 8;
+  uint32_t seed = 1;  // For jitter and loss
+  // Off: no thread of its own, the owner calls step(). With the host's
+  // virtual clock (see platform.h) that makes a run deterministic.
+  bool threaded = true;
+};
+
+// Counters of one emulated speaker
+struct EmulatorStats {
+  uint32_t connections = 0;  // TCP sessions accepted
+  uint32_t requests = 0;     // Messages handled, TCP and UDP
+  uint32_t datagrams = 0;    // Of which UDP
+  uint32_t writes = 0;       // Values changed by a request
+  uint32_t dropped = 0;      // UDP requests lost
+  uint32_t retransmits = 0;  // TCP requests delayed by a loss
+  uint32_t notifications = 0;
+  uint32_t errors = 0;  // Requests answered with an error
+  uint32_t last_write_us = 0;  // micros() when a request last changed a value
+};
+
+// A Linux stand-in for one SSC speaker (KH 80/120/150 and friends): IPv6 TCP
+// and UDP on one port, several clients at once, and the part of the SSC
+// address space the controller uses:
+//
+//   /audio/out/level, /audio/out/mute
+//   /audio/out/eq2 and /audio/out/eq3: gain, boost, frequency, q (20 bands), desc
+//   /device/identity/product, /device/identity/serial
+//   /device/standby/countdown (read only), /device/standby/enabled
+//   /osc/xid, /osc/ping, /osc/timetag, /osc/feature/timetag
+//   /osc/state/subscribe with "#":{"lifetime":s}
+//
+// Replies mirror the request with the values filled in. An unknown address, a
+// write to a read-only one or a type mismatch makes the reply an /osc/error
+// with status 404, 403 or 400 at that address. Subscribers are notified of
+// changes made by other clients, and get a 310 error once their
+// subscription's lifetime runs out. A message with an /osc/timetag is handled
+// that many seconds later.
+//
+// Everything runs on a thread of its own, or in step() if the config says so;
+// the accessors may be called from any thread.
+class SpeakerEmulator {
+ public:
+  explicit SpeakerEmulator(const EmulatorConfig &config);
+  ~SpeakerEmulator() { stop(); }
+
+  SpeakerEmulator(const SpeakerEmulator &) = delete;
+  SpeakerEmulator &operator=(const SpeakerEmulator &) = delete;
+
+  // Opens the sockets and starts the thread, false if the port is taken
+  bool start();
+  void stop();
+  // Handles whatever has arrived and is due, without waiting. Only for
+  // emulators without a thread.
+  void step();
+
+  // Called with the new level whenever a request changes /audio/out/level,
+  // from the emulator's thread (or step()) with its lock held
+  using LevelListener = std::function<void(float level)>;
+  void set_level_listener(LevelListener listener) { level_listener_ = std::move(listener); }
+
+  uint16_t port() const { return port_; }
+  // "[::1]:port", what the controller's roster needs to reach this speaker on loopback
+  std::string loopback_address() const;
+
+  float level();
+  bool muted();
+  bool in_standby();
+  uint32_t standby_countdown();
+  EmulatorStats stats();
+
+  // Ends standby and restarts the countdown, like an audio signal would
+  void wake();
+  // Takes the speaker off the network (sessions reset, connects refused) or back
+  void set_online(bool online);
+  // Stops answering while sessions stay open and connects still succeed,
+  // like a speaker whose SSC server hangs: requests are read and dropped
+  void set_answering(bool answering);
+
+ protected:
+  enum class Kind : uint8_t { NUMBER, BOOLEAN, STRING, NUMBERS };
+
+  // One SSC address of the emulated state
+  struct Address {
+    std::string path;
+    Kind kind;
+    bool writable;
+    float *number;        // NUMBER and NUMBERS
+    bool *boolean;        // BOOLEAN
+    std::string *string;  // STRING
+    size_t count;         // NUMBERS
+  };
+
+  static const size_t EQ_BANDS = 20;
+  struct Equalizer {
+    float gain[EQ_BANDS];
+    float boost[EQ_BANDS];
+    float frequency[EQ_BANDS];
+    float q[EQ_BANDS];
+    std::string desc;
+  };
+
+  struct Subscription {
+    std::vector<std::string> paths;
+    uint32_t expires{0};  // millis()
+    bool active{false};
+  };
+
+  struct Client {
+    int sock{-1};
+    uint32_t id{0};
+    std::string rx;
+    Subscription subscription;
+    uint32_t last_due{0};  // Replies on a session leave in order
+  };
+
+  // A request waiting for its time to be handled
+  struct Pending {
+    uint32_t due;
+    uint32_t client;             // Client::id, 0 for UDP
+    struct sockaddr_in6 source;  // UDP only
+    std::string message;
+  };
+
+  // How a value of the request is answered, see answer_()
+  enum class Mode : uint8_t { NORMAL, SUBSCRIBE_LIST, SUBSCRIBE, ECHO };
+
+  // What handling one request produced besides the reply
+  struct Outcome {
+    bool error{false};
+    std::vector<std::string> changed;     // Paths written
+    bool subscribe{false};                // The request was an /osc/state/subscribe
+    std::vector<std::string> subscribed;  // Its addresses
+    uint32_t lifetime_s{0};
+  };
+
+  void run_();
+  void service_(uint32_t max_wait_ms);
+  void accept_();
+  void read_client_(Client &client);
+  void read_datagrams_();
+  void queue_request_(uint32_t client, const struct sockaddr_in6 *source, std::string message, uint32_t now);
+  void handle_due_(uint32_t now);
+  std::string handle_(const std::string &message, Client *client, uint32_t now);
+  bool answer_(JsonTokenizer &tokens, JsonToken token, std::string &path, Mode mode, Outcome &outcome,
+               std::string &out);
+  bool answer_array_(JsonTokenizer &tokens, std::string &path, Outcome &outcome, std::string &out);
+  void write_value_(const Address &address, std::string &out) const;
+  void write_error_(int status, const char *desc, Outcome &outcome, std::string &out);
+  Address *find_address_(const std::string &path);
+  void notify_(const std::vector<std::string> &changed, uint32_t writer);
+  void expire_subscriptions_(uint32_t now);
+  void update_standby_(uint32_t now);
+  void activity_(uint32_t now);
+  void send_(Client &client, const std::string &message);
+  void drop_clients_();
+  bool open_sockets_();
+  void close_sockets_();
+  uint32_t delay_(bool datagram, bool &lost);
+
+  EmulatorConfig config_;
+  uint16_t port_{0};
+  std::mutex mutex_;  // Everything below, held by the thread while it works
+  std::thread thread_;
+  std::atomic<bool> running_{false};
+  int listener_{-1};
+  int udp_{-1};
+  int wake_pipe_[2]{-1, -1};  // Interrupts select() for stop() and set_online()
+  bool online_{true};
+  bool answering_{true};
+  std::vector<Client> clients_;
+  uint32_t next_client_id_{1};
+  std::deque<Pending> pending_;
+  std::mt19937 random_;
+  EmulatorStats stats_;
+  LevelListener level_listener_;
+
+  float level_{60.0f};
+  bool mute_{false};
+  Equalizer eq2_{};
+  Equalizer eq3_{};
+  std::string product_;
+  std::string serial_;
+  bool standby_enabled_{true};
+  bool standby_{false};
+  float countdown_{0.0f};
+  uint32_t last_activity_{0};
+  uint32_t standby_since_{0};
+  std::vector<Address> addresses_;
+};
+
+}  // namespace emulator
+}  // namespace vol_ctrl
+}  // namespace esphome
@@ -0,0 +1,194 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+
+#include "discovery.h"
+#include "network.h"
+#include "platform.h"
+#include "ssc_emulator.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using emulator::EmulatorConfig;
+using emulator::SpeakerEmulator;
+
+// Stands in for the speakers' mDNS responders on loopback: answers every
+// query for _ssc._tcp.local with one service instance per port, each on its
+// own host name that resolves to ::1
+class MdnsResponder {
+ public:
+  explicit MdnsResponder(std::vector<uint16_t> ports) : ports_(std::move(ports)) {
+    sock_ = socket(AF_INET6, SOCK_DGRAM, 0);
+    struct sockaddr_in6 addr {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    bind(sock_, (struct sockaddr *) &addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(sock_, (struct sockaddr *) &addr, &len);
+    port_ = ntohs(addr.sin6_port);
+    thread_ = std::thread([this]() { this->serve_(); });
+  }
+  ~MdnsResponder() {
+    stop_ = true;
+    thread_.join();
+    ::close(sock_);
+  }
+
+  uint16_t port() const { return port_; }
+  int queries() const { return queries_; }
+
+ protected:
+  static void put_name(std::string &out, const std::string &name) {
+    size_t start = 0;
+    while (start < name.size()) {
+      size_t dot = name.find('.', start);
+      if (dot == std::string::npos) {
+        dot = name.size();
+      }
+      out += static_cast<char>(dot - start);
+      out.append(name, start, dot - start);
+      start = dot + 1;
+    }
+    out += '\0';
+  }
+  static void put_u16(std::string &out, uint16_t value) {
+    out += static_cast<char>(value >> 8);
+    out += static_cast<char>(value & 0xFF);
+  }
+  static void put_record(std::string &out, const std::string &owner, uint16_t type, const std::string &data) {
+    put_name(out, owner);
+    put_u16(out, type);
+    put_u16(out, 1);  // IN
+    put_u16(out, 0);
+    put_u16(out, 120);  // TTL
+    put_u16(out, data.size());
+    out += data;
+  }
+
+  std::string answer_() const {
+    std::string out;
+    put_u16(out, 0);       // ID
+    put_u16(out, 0x8400);  // Authoritative response
+    put_u16(out, 0);       // Questions
+    put_u16(out, ports_.size());
+    put_u16(out, 0);
+    put_u16(out, ports_.size() * 2);
+    for (size_t i = 0; i < ports_.size(); i++) {
+      std::string instance;
+      put_name(instance, "speaker" + std::to_string(i) + "._ssc._tcp.local");
+      put_record(out, "_ssc._tcp.local", 12, instance);
+    }
+    for (size_t i = 0; i < ports_.size(); i++) {
+      std::string host = "speaker" + std::to_string(i) + ".local";
+      std::string service;
+      put_u16(service, 0);  // Priority
+      put_u16(service, 0);  // Weight
+      put_u16(service, ports_[i]);
+      put_name(service, host);
+      put_record(out, "speaker" + std::to_string(i) + "._ssc._tcp.local", 33, service);
+      put_record(out, host, 28, std::string(reinterpret_cast<const char *>(&in6addr_loopback), 16));
+    }
+    return out;
+  }
+
+  void serve_() {
+    struct pollfd fd = {sock_, POLLIN, 0};
+    while (!stop_) {
+      if (poll(&fd, 1, 10) <= 0) {
+        continue;
+      }
+      char query[512];
+      struct sockaddr_in6 from;
+      socklen_t from_len = sizeof(from);
+      ssize_t len = recvfrom(sock_, query, sizeof(query), 0, (struct sockaddr *) &from, &from_len);
+      if (len <= 12 || std::string(query, len).find("\x04_ssc\x04_tcp\x05local") == std::string::npos) {
+        continue;
+      }
+      queries_++;
+      std::string answer = this->answer_();
+      sendto(sock_, answer.data(), answer.size(), 0, (struct sockaddr *) &from, from_len);
+    }
+  }
+
+  std::vector<uint16_t> ports_;
+  int sock_{-1};
+  uint16_t port_{0};
+  std::atomic<bool> stop_{false};
+  std::atomic<int> queries_{0};
+  std::thread thread_;
+};
+
+static std::unique_ptr<SpeakerEmulator> start_speaker(const std::string &serial) {
+  EmulatorConfig config;
+  config.address = "::1";
+  config.port = 0;
+  config.serial = serial;
+  std::unique_ptr<SpeakerEmulator> speaker(new SpeakerEmulator(config));
+  return speaker->start() ? std::move(speaker) : nullptr;
+}
+
+// Runs the controller's main loop until done() holds
+static bool loop_until(const std::function<bool()> &done, uint32_t timeout_ms = 5000) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start > timeout_ms) {
+      return false;
+    }
+    network::loop();
+    usleep(500);
+  }
+  return true;
+}
+
+// One speaker in the roster, answering at its roster address and at a
+// second one, and one new speaker answering at two addresses. Emulators with
+// the same serial stand for one speaker's addresses.
+TEST(Discovery, RegistersEverySpeakerOnce) {
+  std::unique_ptr<SpeakerEmulator> roster_speaker = start_speaker("SN1");
+  std::unique_ptr<SpeakerEmulator> roster_alias = start_speaker("SN1");
+  std::unique_ptr<SpeakerEmulator> new_speaker = start_speaker("SN2");
+  std::unique_ptr<SpeakerEmulator> new_alias = start_speaker("SN2");
+  ASSERT_TRUE(roster_speaker && roster_alias && new_speaker && new_alias);
+
+  std::string address = roster_speaker->loopback_address();
+  static network::SpeakerConfig roster[1] = {{"Desk", nullptr, network::SpeakerRole::FULL_RANGE, 0, 0.0f}};
+  roster[0].ipv6 = address.c_str();
+  network::init(roster, 1);
+  ASSERT_EQ(network::device_count(), 1);
+  ASSERT_TRUE(loop_until([]() { return network::find_device_by_identity("KH 150-SN1") == 0; }));
+
+  MdnsResponder responder({roster_speaker->port(), roster_alias->port(), new_speaker->port(), new_alias->port()});
+  host_mdns_port() = responder.port();
+
+  bool done = false;
+  network::DiscoveryResult result;
+  ASSERT_TRUE(network::start_discovery([&](const network::DiscoveryResult &reply) {
+    done = true;
+    result = reply;
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_GE(responder.queries(), 1);
+  EXPECT_EQ(result.found, 2);
+  ASSERT_EQ(network::device_count(), 2);
+  EXPECT_EQ(result.added, network::device_bit(1));
+  EXPECT_STREQ(network::get_device_name(1), "KH 150-SN2");
+
+  // A second run finds the same two speakers and adds nothing
+  ASSERT_TRUE(loop_until([]() { return network::find_device_by_identity("KH 150-SN2") == 1; }));
+  done = false;
+  ASSERT_TRUE(network::start_discovery([&](const network::DiscoveryResult &reply) {
+    done = true;
+    result = reply;
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_EQ(result.found, 2);
+  EXPECT_EQ(result.added, 0u);
+  EXPECT_EQ(network::device_count(), 2);
+  host_mdns_port() = 0;
+}
@@ -0,0 +1,268 @@
+#include <gtest/gtest.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "network.h"
+#include "platform.h"
+#include "ssc_emulator.h"
+#include "ssc_json.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using emulator::EmulatorConfig;
+using emulator::SpeakerEmulator;
+
+// network.cpp keeps one device table per process, so every test shares this
+// roster: two emulated speakers on loopback, the right one trimmed by -2 dB,
+// and a third in another group whose firmware ignores /osc/xid. The third is
+// reached at the longest form of an IPv4-mapped address.
+class NetworkEmulatorTest : public ::testing::Test {
+ protected:
+  static void SetUpTestSuite() {
+    EmulatorConfig config;
+    config.address = "::1";
+    config.port = 0;
+    config.latency_ms = 2;
+    config.jitter_ms = 2;
+    for (int i = 0; i < 2; i++) {
+      speakers[i].reset(new SpeakerEmulator(config));
+      ASSERT_TRUE(speakers[i]->start());
+    }
+    config.address = "::";
+    config.reflect_xid = false;
+    speakers[2].reset(new SpeakerEmulator(config));
+    ASSERT_TRUE(speakers[2]->start());
+    static network::SpeakerConfig roster[3] = {
+        {"Left", nullptr, network::SpeakerRole::LEFT, 0, 0.0f},
+        {"Right", nullptr, network::SpeakerRole::RIGHT, 0, -2.0f},
+        {"Old", nullptr, network::SpeakerRole::FULL_RANGE, 1, 0.0f},
+    };
+    addresses[0] = speakers[0]->loopback_address();
+    addresses[1] = speakers[1]->loopback_address();
+    addresses[2] = "[0000:0000:0000:0000:0000:ffff:127.0.0.1]:" + std::to_string(speakers[2]->port());
+    for (int i = 0; i < 3; i++) {
+      roster[i].ipv6 = addresses[i].c_str();
+    }
+    network::init(roster, 3);
+    ASSERT_EQ(network::device_count(), 3);
+  }
+
+  static void TearDownTestSuite() {
+    for (auto &speaker : speakers) {
+      speaker.reset();
+    }
+  }
+
+  // Runs the controller's main loop until done() holds
+  static bool loop_until(const std::function<bool()> &done, uint32_t timeout_ms = 3000) {
+    uint32_t start = millis();
+    while (!done()) {
+      if (millis() - start > timeout_ms) {
+        return false;
+      }
+      network::loop();
+      usleep(500);
+    }
+    return true;
+  }
+
+  static std::unique_ptr<SpeakerEmulator> speakers[3];
+  static std::string addresses[3];
+};
+
+std::unique_ptr<SpeakerEmulator> NetworkEmulatorTest::speakers[3];
+std::string NetworkEmulatorTest::addresses[3];
+
+TEST_F(NetworkEmulatorTest, SetsAndReadsOneSpeaker) {
+  bool done = false;
+  bool result = false;
+  ASSERT_TRUE(network::set_device_volume(0, 55.5f, [&](bool success) {
+    done = true;
+    result = success;
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_TRUE(result);
+  EXPECT_FLOAT_EQ(speakers[0]->level(), 55.5f);
+
+  done = false;
+  network::DeviceVolStdbyData data;
+  ASSERT_TRUE(network::get_device_data(0, [&](bool is_up, const network::DeviceVolStdbyData &reply) {
+    done = true;
+    result = is_up;
+    data = reply;
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_TRUE(result);
+  EXPECT_FLOAT_EQ(data.volume, 55.5f);
+  EXPECT_FALSE(data.mute);
+  EXPECT_GT(data.standby_countdown, 0);
+}
+
+TEST_F(NetworkEmulatorTest, SetsTheGroupWithTrim) {
+  bool done = false;
+  size_t succeeded = 0;
+  ASSERT_TRUE(network::set_group_volume(network::device_bit(0) | network::device_bit(1), 50.0f,
+                                        [&](const network::GroupResult &result) {
+                                          done = true;
+                                          succeeded = result.succeeded();
+                                        }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_EQ(succeeded, 2u);
+  EXPECT_FLOAT_EQ(speakers[0]->level(), 50.0f);
+  EXPECT_FLOAT_EQ(speakers[1]->level(), 48.0f);
+
+  done = false;
+  ASSERT_TRUE(network::set_group_mute(network::device_bit(0) | network::device_bit(1), true,
+                                      [&](const network::GroupResult &result) {
+                                        done = true;
+                                        succeeded = result.succeeded();
+                                      }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_EQ(succeeded, 2u);
+  EXPECT_TRUE(speakers[0]->muted());
+  EXPECT_TRUE(speakers[1]->muted());
+}
+
+TEST_F(NetworkEmulatorTest, ReportsChangesFromOtherClients) {
+  ASSERT_TRUE(loop_until([]() { return network::is_subscribed(0); }));
+  float reported = -1.0f;
+  network::set_state_listener([&](network::DeviceId id, const network::DeviceStateUpdate &update) {
+    if (id == 0 && update.has_volume) {
+      reported = update.volume;
+    }
+  });
+
+  // Someone else turns the speaker down, e.g. the KH Tool
+  network::SscConnection other;
+  struct sockaddr_in6 addr;
+  ASSERT_TRUE(network::parse_ssc_address(addresses[0].c_str(), addr));
+  other.set_address(addresses[0].c_str(), addr);
+  bool answered = false;
+  other.submit("{\"audio\":{\"out\":{\"level\":42}}}", [&](bool success, Slice) { answered = success; });
+  ASSERT_TRUE(loop_until([&]() {
+    other.poll(millis());
+    return answered && reported == 42.0f;
+  }));
+  network::set_state_listener(nullptr);
+}
+
+TEST_F(NetworkEmulatorTest, AnswersSscErrors) {
+  bool done = false;
+  std::string response;
+  ASSERT_TRUE(network::send_ssc_command(0, "{\"audio\":{\"out\":{\"volume\":1}}}",
+                                        [&](bool success, const std::string &reply) {
+                                          done = success;
+                                          response = reply;
+                                        }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_EQ(ssc_error_status(response, "/audio/out/volume"), 404) << response;
+}
+
+// Its replies are matched in order, so a notification would be taken for the
+// reply to the oldest request: the speaker is polled and never subscribed
+TEST_F(NetworkEmulatorTest, PollsSpeakersThatIgnoreXid) {
+  bool done = false;
+  ASSERT_TRUE(network::set_device_volume(2, 30.0f, [&](bool success) { done = success; }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+
+  network::SscConnection other;
+  struct sockaddr_in6 addr;
+  ASSERT_TRUE(network::parse_ssc_address(addresses[2].c_str(), addr));
+  other.set_address(addresses[2].c_str(), addr);
+  bool answered = false;
+  other.submit("{\"audio\":{\"out\":{\"level\":35}}}", [&](bool success, Slice) { answered = success; });
+  ASSERT_TRUE(loop_until([&]() {
+    other.poll(millis());
+    return answered;
+  }));
+  uint32_t start = millis();
+  loop_until([&]() { return millis() - start > 200; });
+
+  EXPECT_FALSE(network::is_subscribed(2));
+  EXPECT_EQ(speakers[2]->stats().notifications, 0u);
+  done = false;
+  network::DeviceVolStdbyData data;
+  ASSERT_TRUE(network::get_device_data(2, [&](bool is_up, const network::DeviceVolStdbyData &reply) {
+    done = is_up;
+    data = reply;
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_FLOAT_EQ(data.volume, 35.0f);
+}
+
+TEST_F(NetworkEmulatorTest, RestoresLongAddressesFromTheBootCache) {
+  EXPECT_FALSE(network::restore_device_states());  // Nothing cached yet
+  DeviceState &state = network::edit_device_state(2);
+  state.is_up = true;
+  state.set_volume(25.0f);
+  network::publish_device_states();
+  EXPECT_STREQ(network::read_device_states().devices[2].ipv6, addresses[2].c_str());
+
+  // As on the next boot
+  state.stale = false;
+  EXPECT_TRUE(network::restore_device_states());
+  EXPECT_TRUE(network::get_device_state(2).stale);
+}
+
+// A poll that fails must not wipe the level restored from the boot cache:
+// the display keeps showing it, marked stale, until the speaker answers
+TEST_F(NetworkEmulatorTest, FailedPollKeepsTheCachedLevel) {
+  network::restore_device_states();  // As at boot, before anything is published
+  DeviceState &state = network::edit_device_state(2);
+  state.is_up = true;
+  state.set_volume(33.0f);
+  network::publish_device_states();
+  ASSERT_TRUE(network::restore_device_states());
+  ASSERT_TRUE(state.stale);
+
+  speakers[2]->set_online(false);
+  bool done = false;
+  network::DeviceStateUpdate update;
+  ASSERT_TRUE(network::get_device_data(2, [&](bool is_up, const network::DeviceVolStdbyData &data) {
+    done = true;
+    update = network::DeviceStateUpdate(is_up, data);
+  }));
+  ASSERT_TRUE(loop_until([&]() { return done; }));
+  EXPECT_FALSE(update.is_up);
+  EXPECT_FALSE(update.has_volume || update.has_mute || update.has_standby_countdown);
+
+  // As VolCtrl::apply_state_update_() does
+  state.set_is_up(update.is_up);
+  if (update.has_volume) {
+    state.stale = false;
+    state.set_volume(update.volume);
+  }
+  EXPECT_FLOAT_EQ(state.get_volume(), 33.0f);
+  EXPECT_TRUE(state.stale);
+
+  // Back for the tests that follow
+  speakers[2]->set_online(true);
+  done = false;
+  ASSERT_TRUE(network::get_device_data(2, [&](bool is_up, const network::DeviceVolStdbyData &) { done = is_up; }));
+  EXPECT_TRUE(loop_until([&]() { return done; }));
+}
+
+// A speaker that keeps its session but stops answering is reported down by
+// the heartbeat after two missed pings, and up again by the first answer
+TEST_F(NetworkEmulatorTest, HeartbeatTracksASpeakerThatStopsAnswering) {
+  std::vector<bool> liveness;  // Updates that carry nothing but is_up
+  network::set_state_listener([&](network::DeviceId id, const network::DeviceStateUpdate &update) {
+    if (id == 1 && !update.has_volume && !update.has_mute && !update.has_standby_countdown) {
+      liveness.push_back(update.is_up);
+    }
+  });
+
+  speakers[1]->set_answering(false);
+  ASSERT_TRUE(loop_until([&]() { return !liveness.empty(); }, 8000));
+  EXPECT_FALSE(liveness.back());
+  // Connects still succeed, so this was the heartbeat and not the breaker
+  EXPECT_NE(network::read_link_stats().devices[1].link, network::LinkState::DOWN);
+
+  speakers[1]->set_answering(true);
+  ASSERT_TRUE(loop_until([&]() { return liveness.size() > 1; }, 5000));
+  EXPECT_TRUE(liveness.back());
+  EXPECT_EQ(liveness.size(), 2u);
+  network::set_state_listener(nullptr);
+}
@@ -0,0 +1,81 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include "seqlock.h"
+
+using namespace esphome::vol_ctrl;
+
+// Every word carries the same number, a torn read mixes two of them. Large
+// enough that copies get preempted halfway even on a single core.
+struct Stamped {
+  uint32_t words[1024];
+};
+
+static Stamped stamped(uint32_t value) {
+  Stamped result;
+  for (uint32_t &word : result.words) {
+    word = value;
+  }
+  return result;
+}
+
+// One writer and several readers race for real; build with VOL_CTRL_TSAN=ON to
+// have ThreadSanitizer check the memory orderings as well
+TEST(SeqLock, ReadersNeverSeeTornValues) {
+  static const uint32_t STORES = 20000;
+  static const int READERS = 4;
+  SeqLock<Stamped> lock;
+  std::atomic<bool> done{false};
+  std::atomic<uint32_t> torn{0};
+  std::atomic<uint32_t> backwards{0};
+  std::atomic<uint32_t> reads{0};
+
+  std::vector<std::thread> readers;
+  for (int i = 0; i < READERS; i++) {
+    readers.emplace_back([&]() {
+      uint32_t last = 0;
+      uint32_t count = 0;
+      while (!done.load(std::memory_order_acquire)) {
+        Stamped value = lock.load();
+        for (uint32_t word : value.words) {
+          if (word != value.words[0]) {
+            torn++;
+            break;
+          }
+        }
+        if (value.words[0] < last) {
+          backwards++;
+        }
+        last = value.words[0];
+        count++;
+      }
+      reads += count;
+    });
+  }
+  std::thread writer([&]() {
+    for (uint32_t i = 1; i <= STORES; i++) {
+      lock.store(stamped(i));
+    }
+    done.store(true, std::memory_order_release);
+  });
+
+  writer.join();
+  for (std::thread &reader : readers) {
+    reader.join();
+  }
+  EXPECT_EQ(torn.load(), 0u);
+  EXPECT_EQ(backwards.load(), 0u);
+  EXPECT_GT(reads.load(), 0u);
+  EXPECT_EQ(lock.version(), STORES);
+  EXPECT_EQ(lock.load().words[1023], STORES);
+}
+
+TEST(SeqLock, StartsZeroed) {
+  SeqLock<Stamped> lock;
+  EXPECT_EQ(lock.version(), 0u);
+  EXPECT_EQ(lock.load().words[0], 0u);
+}
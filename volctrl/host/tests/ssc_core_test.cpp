@@ -0,0 +1,294 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "device_state.h"
+#include "platform.h"
+#include "ssc_connection.h"
+#include "ssc_json.h"
+#include "ssc_message.h"
+#include "utils.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using network::SscConnection;
+
+static const char STATE_REPLY[] =
+    "{\"osc\":{\"xid\":7},\"device\":{\"standby\":{\"countdown\":5400}},"
+    "\"audio\":{\"out\":{\"level\":62.5,\"mute\":false,\"eq2\":{\"gain\":[0,-1.5,3]}}}}";
+
+TEST(SscJson, ParsesFieldsInOnePass) {
+  SscField fields[] = {{"/audio/out/level", SscField::Type::NUMBER},
+                       {"/audio/out/mute", SscField::Type::BOOLEAN},
+                       {"/device/standby/countdown", SscField::Type::NUMBER},
+                       {"/audio/out/eq2/gain/1", SscField::Type::NUMBER},
+                       {"/audio/out/missing", SscField::Type::NUMBER}};
+  EXPECT_EQ(parse_ssc_fields(STATE_REPLY, fields, 5), 4u);
+  EXPECT_FLOAT_EQ(fields[0].number, 62.5f);
+  EXPECT_FALSE(fields[1].boolean);
+  EXPECT_FLOAT_EQ(fields[2].number, 5400.0f);
+  EXPECT_FLOAT_EQ(fields[3].number, -1.5f);
+  EXPECT_FALSE(fields[4].found);
+}
+
+TEST(SscJson, BareNameMatchesAtAnyDepth) {
+  float level = 0.0f;
+  EXPECT_TRUE(ssc_query(STATE_REPLY, "level", level));
+  EXPECT_FLOAT_EQ(level, 62.5f);
+}
+
+TEST(SscJson, KeepsFieldsFoundBeforeAnError) {
+  SscField fields[] = {{"/audio/out/level", SscField::Type::NUMBER},
+                       {"/audio/out/mute", SscField::Type::BOOLEAN}};
+  EXPECT_EQ(parse_ssc_fields("{\"audio\":{\"out\":{\"level\":3,\"mute\":tru}}}", fields, 2), 1u);
+  EXPECT_TRUE(fields[0].found);
+  EXPECT_FALSE(fields[1].found);
+}
+
+TEST(SscJson, ReadsErrorStatus) {
+  EXPECT_EQ(ssc_error_status(STATE_REPLY), 0);
+  EXPECT_EQ(ssc_error_status("{\"osc\":{\"error\":[400,{\"desc\":\"malformed message\"}]}}"), 400);
+  const char *terminated = "{\"osc\":{\"error\":[{\"osc\":{\"state\":{\"subscribe\":[310,{}]}}}]}}";
+  EXPECT_EQ(ssc_error_status(terminated), 0);  // Not about the message as a whole
+  EXPECT_EQ(ssc_error_status(terminated, "/osc/state/subscribe"), 310);
+  EXPECT_EQ(ssc_error_status(terminated, "/audio/out/level"), 0);
+  // A level of 310 is no error
+  EXPECT_EQ(ssc_error_status("{\"audio\":{\"out\":{\"level\":310}}}", "/audio/out/level"), 0);
+}
+
+TEST(SscJson, RejectsMalformedMessages) {
+  const char *messages[] = {"", "{", "{\"a\":}", "{\"a\":1,}", "[1 2]", "{\"a\":1}x", "{\"a\":\"open}"};
+  for (const char *message : messages) {
+    JsonTokenizer tokenizer(message);
+    JsonToken token;
+    do {
+      token = tokenizer.next();
+    } while (token != JsonToken::END && token != JsonToken::INVALID);
+    EXPECT_EQ(token, JsonToken::INVALID) << message;
+  }
+}
+
+TEST(Utils, ExtractsValuesByKey) {
+  std::string value;
+  EXPECT_TRUE(utils::extract_json_value("{\"name\":\"KH 80\",\"level\":60}", "name", value));
+  EXPECT_EQ(value, "KH 80");
+  bool muted = true;
+  EXPECT_TRUE(utils::check_json_boolean(STATE_REPLY, "mute", muted));
+  EXPECT_FALSE(muted);
+  float countdown = 0.0f;
+  EXPECT_TRUE(utils::extract_json_number(STATE_REPLY, "countdown", countdown));
+  EXPECT_FLOAT_EQ(countdown, 5400.0f);
+}
+
+static constexpr auto LEVEL = ssc_path("/audio/out/level");
+static constexpr auto MUTE = ssc_path("/audio/out/mute");
+static constexpr auto TIMETAG = ssc_path("/osc/timetag");
+static constexpr auto EQ_GAIN = ssc_path("/audio/out/eq2/gain");
+
+TEST(SscMessage, BuildsSkeletonsAtCompileTime) {
+  static_assert(LEVEL.open_size == 24 && LEVEL.close_size == 2, "level skeleton");
+  EXPECT_EQ(LEVEL.opening().to_string(), "\"audio\":{\"out\":{\"level\":");
+  EXPECT_EQ(LEVEL.closing().to_string(), "}}");
+}
+
+TEST(SscMessage, PrintsValues) {
+  SscMessage<SSC_COMMAND_SIZE> message;
+  message.begin().set(LEVEL, 62.5f).end();
+  EXPECT_EQ(message.slice().to_string(), "{\"audio\":{\"out\":{\"level\":62.5}}}");
+
+  message.clear();
+  message.begin().set(TIMETAG, 0.125f, 3).set(LEVEL, -3.0f).end();
+  EXPECT_EQ(message.slice().to_string(), "{\"osc\":{\"timetag\":0.125},\"audio\":{\"out\":{\"level\":-3}}}");
+
+  message.clear();
+  message.begin().set(MUTE, true).end();
+  EXPECT_EQ(message.slice().to_string(), "{\"audio\":{\"out\":{\"mute\":true}}}");
+
+  const float gains[] = {0.0f, -1.5f, 3.25f};
+  message.clear();
+  message.begin().set(EQ_GAIN, gains, 3).end();
+  EXPECT_EQ(message.slice().to_string(), "{\"audio\":{\"out\":{\"eq2\":{\"gain\":[0,-1.5,3.25]}}}}");
+  EXPECT_FALSE(message.overflowed());
+}
+
+TEST(SscMessage, ReportsOverflow) {
+  SscMessage<16> message;
+  message.begin().set(LEVEL, 1.0f).end();
+  EXPECT_TRUE(message.overflowed());
+  EXPECT_EQ(message.size(), 16u);
+}
+
+TEST(SscMessage, RoundTripsThroughTheParser) {
+  SscMessage<SSC_COMMAND_SIZE> message;
+  message.begin().set(LEVEL, 71.25f).end();
+  float level = 0.0f;
+  EXPECT_TRUE(ssc_query(message, "/audio/out/level", level));
+  EXPECT_FLOAT_EQ(level, 71.25f);
+}
+
+TEST(Xid, TagsAndExtracts) {
+  std::string payload;
+  network::tag_with_xid("{\"audio\":{\"out\":{\"level\":3}}}", 42, payload);
+  EXPECT_EQ(payload, "{\"osc\":{\"xid\":42},\"audio\":{\"out\":{\"level\":3}}}");
+  network::tag_with_xid("{\"osc\":{\"ping\":null}}", 43, payload);
+  EXPECT_EQ(payload, "{\"osc\":{\"xid\":43,\"ping\":null}}");
+
+  uint32_t xid = 0;
+  EXPECT_TRUE(network::extract_xid(payload, xid));
+  EXPECT_EQ(xid, 43u);
+  EXPECT_FALSE(network::extract_xid("{\"audio\":{}}", xid));
+}
+
+TEST(DeviceState, ReportsChanges) {
+  DeviceState state;
+  EXPECT_TRUE(state.set_volume(60.0f));
+  EXPECT_FALSE(state.set_volume(60.0f));
+  EXPECT_TRUE(state.set_mute(true));
+  EXPECT_TRUE(state.set_is_up(true));
+}
+
+// Speaker stand-in on [::1]: echoes every message back as its reply, which
+// reflects the xid the way a real speaker does. Several replies may go out in
+// one segment and a reply may be split across segments, to exercise framing.
+class EchoSpeaker {
+ public:
+  EchoSpeaker() {
+    listener_ = socket(AF_INET6, SOCK_STREAM, 0);
+    struct sockaddr_in6 addr {};
+    addr.sin6_family = AF_INET6;
+    addr.sin6_addr = in6addr_loopback;
+    bind(listener_, (struct sockaddr *) &addr, sizeof(addr));
+    socklen_t len = sizeof(addr);
+    getsockname(listener_, (struct sockaddr *) &addr, &len);
+    port_ = ntohs(addr.sin6_port);
+    listen(listener_, 1);
+    thread_ = std::thread([this]() { this->serve_(); });
+  }
+  ~EchoSpeaker() {
+    shutdown(listener_, SHUT_RDWR);
+    ::close(listener_);
+    thread_.join();
+  }
+
+  uint16_t port() const { return port_; }
+  int messages() const { return messages_; }
+
+ protected:
+  void serve_() {
+    int sock = accept(listener_, nullptr, nullptr);
+    if (sock < 0) {
+      return;
+    }
+    int nodelay = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    std::string pending;
+    char buffer[512];
+    ssize_t received;
+    while ((received = recv(sock, buffer, sizeof(buffer), 0)) > 0) {
+      pending.append(buffer, received);
+      std::string replies;
+      size_t end;
+      while ((end = pending.find("\r\n")) != std::string::npos) {
+        replies += pending.substr(0, end + 2);
+        pending.erase(0, end + 2);
+        messages_++;
+      }
+      // First half, then the rest, so the client sees a partial message
+      size_t half = replies.size() / 2;
+      send(sock, replies.data(), half, 0);
+      send(sock, replies.data() + half, replies.size() - half, 0);
+    }
+    ::close(sock);
+  }
+
+  int listener_{-1};
+  uint16_t port_{0};
+  std::atomic<int> messages_{0};
+  std::thread thread_;
+};
+
+static bool poll_until(SscConnection &connection, const std::function<bool()> &done) {
+  uint32_t start = millis();
+  while (!done()) {
+    if (millis() - start > 2000) {
+      return false;
+    }
+    connection.poll(millis());
+    usleep(200);
+  }
+  return true;
+}
+
+TEST(SscConnection, MatchesRepliesAndCoalescesWrites) {
+  EchoSpeaker speaker;
+  struct sockaddr_in6 addr;
+  ASSERT_TRUE(network::parse_ssc_address("::1", addr));
+  addr.sin6_port = htons(speaker.port());
+  SscConnection connection;
+  connection.set_address("::1", addr);
+
+  // Three level writes before the session is even open: one goes out
+  std::vector<std::string> levels;
+  for (int level = 60; level < 63; level++) {
+    std::string command = "{\"audio\":{\"out\":{\"level\":" + std::to_string(level) + "}}}";
+    ASSERT_TRUE(connection.submit(command, [&levels](bool success, Slice response) {
+      EXPECT_TRUE(success);
+      levels.push_back(response.to_string());
+    }, "/audio/out/level"));
+  }
+  int pings = 0;
+  for (int i = 0; i < 4; i++) {
+    ASSERT_TRUE(connection.submit("{\"osc\":{\"ping\":null}}", [&pings](bool success, Slice) {
+      EXPECT_TRUE(success);
+      pings++;
+    }));
+  }
+
+  ASSERT_TRUE(poll_until(connection, [&]() { return connection.is_idle(); }));
+  EXPECT_EQ(speaker.messages(), 5);
+  EXPECT_EQ(pings, 4);
+  ASSERT_EQ(levels.size(), 3u);
+  for (const std::string &reply : levels) {
+    EXPECT_NE(reply.find("\"level\":62"), std::string::npos) << reply;
+  }
+  EXPECT_EQ(connection.get_health().transactions, 5u);
+}
+
+// Discovery reuses its probe sessions run after run, a speaker that was off
+// last time must be probed this time
+TEST(SscConnection, ReusedSessionStartsHealthy) {
+  EchoSpeaker speaker;  // Outlives the session, it serves until the session closes
+  struct sockaddr_in6 closed;
+  ASSERT_TRUE(network::parse_ssc_address("::1", closed));
+  {
+    EchoSpeaker gone;  // A port nobody listens on once it is destroyed
+    closed.sin6_port = htons(gone.port());
+  }
+  SscConnection connection;
+  connection.set_address("::1", closed);
+  int failures = 0;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(connection.submit("{\"osc\":{\"ping\":null}}", [&failures](bool success, Slice) {
+      EXPECT_FALSE(success);
+      failures++;
+    }));
+    ASSERT_TRUE(poll_until(connection, [&]() { return failures == i + 1; }));
+  }
+  ASSERT_TRUE(connection.is_down());
+  EXPECT_FALSE(connection.submit("{\"osc\":{\"ping\":null}}", nullptr));
+
+  struct sockaddr_in6 addr = closed;
+  addr.sin6_port = htons(speaker.port());
+  connection.set_address("::1", addr);
+  EXPECT_FALSE(connection.is_down());
+  EXPECT_EQ(connection.get_health().failures, 0u);
+  bool answered = false;
+  ASSERT_TRUE(connection.submit("{\"osc\":{\"ping\":null}}", [&answered](bool success, Slice) {
+    answered = success;
+  }));
+  ASSERT_TRUE(poll_until(connection, [&]() { return answered; }));
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "platform.h"
+#include "ssc_connection.h"
+#include "ssc_emulator.h"
+
+using namespace esphome;
+using namespace esphome::vol_ctrl;
+using emulator::EmulatorConfig;
+using emulator::SpeakerEmulator;
+using network::SscConnection;
+
+static const char PING[] = "{\"osc\":{\"ping\":null}}";
+static const char DELAYED_PING[] = "{\"osc\":{\"timetag\":1,\"ping\":null}}";
+static const char LEVEL_PATH[] = "/audio/out/level";
+
+static std::string level_command(float level) {
+  return "{\"audio\":{\"out\":{\"level\":" + std::to_string(level) + "}}}";
+}
+
+// One session against one emulated speaker, both driven from the test on the
+// host's virtual clock, so timeouts and backoffs take no real time and every
+// round trip is exactly the configured latency
+class SessionTest : public ::testing::Test {
+ protected:
+  void SetUp() override { host_virtual_time_us() = 1000000; }
+
+  void TearDown() override {
+    connection.close();
+    speaker.reset();
+    host_virtual_time_us() = -1;
+  }
+
+  void start(EmulatorConfig config = EmulatorConfig()) {
+    config.address = "::1";
+    config.port = 0;
+    config.threaded = false;
+    speaker.reset(new SpeakerEmulator(config));
+    ASSERT_TRUE(speaker->start());
+    address = speaker->loopback_address();
+    struct sockaddr_in6 addr;
+    ASSERT_TRUE(network::parse_ssc_address(address.c_str(), addr));
+    connection.set_address(address.c_str(), addr);
+  }
+
+  // Advances the clock a millisecond at a time until done() holds
+  bool run_until(const std::function<bool()> &done, uint32_t timeout_ms = 5000) {
+    for (uint32_t elapsed = 0; !done(); elapsed++) {
+      if (elapsed >= timeout_ms) {
+        return false;
+      }
+      host_virtual_time_us() += 1000;
+      speaker->step();
+      connection.poll(millis());
+    }
+    return true;
+  }
+
+  void run_for(uint32_t ms) {
+    uint32_t end = millis() + ms;
+    run_until([end]() { return millis() >= end; }, ms + 1);
+  }
+
+  // Submits one command and waits for its outcome
+  bool transact(const std::string &command, std::string *reply = nullptr) {
+    bool done = false;
+    bool result = false;
+    if (!connection.submit(command, [&](bool success, Slice response) {
+          done = true;
+          result = success;
+          if (reply != nullptr) {
+            *reply = response.to_string();
+          }
+        })) {
+      return false;
+    }
+    return run_until([&]() { return done; }) && result;
+  }
+
+  std::unique_ptr<SpeakerEmulator> speaker;  // Outlives the session
+  std::string address;
+  SscConnection connection;
+};
+
+// The breaker opens after DOWN_AFTER_FAILURES failed connects, probes with a
+// doubling backoff, and replays the level the user chose meanwhile
+TEST_F(SessionTest, BreakerBacksOffAndReplaysTheJournal) {
+  start();
+  ASSERT_TRUE(transact(PING));
+  speaker->set_online(false);
+
+  for (uint32_t i = 0; i < SscConnection::DOWN_AFTER_FAILURES; i++) {
+    EXPECT_FALSE(connection.is_down());
+    EXPECT_FALSE(transact(PING));
+  }
+  ASSERT_TRUE(connection.is_down());
+  const uint32_t max_backoff = SscConnection::BACKOFF_MAX_MS;
+  uint32_t expected = SscConnection::BACKOFF_MIN_MS;
+  EXPECT_EQ(connection.get_health().backoff_ms, expected);
+
+  // Refused at once; only writes that name their path are kept
+  EXPECT_FALSE(connection.submit(PING, nullptr));
+  EXPECT_FALSE(connection.submit(level_command(40.0f), nullptr, LEVEL_PATH));
+  EXPECT_FALSE(connection.submit(level_command(45.0f), nullptr, LEVEL_PATH));
+
+  for (int probe = 0; probe < 6; probe++) {
+    uint32_t failures = connection.get_health().failures;
+    uint32_t next_probe = connection.get_health().next_probe;
+    run_for(next_probe - millis() - 1);
+    EXPECT_EQ(connection.get_health().failures, failures) << "probed before the backoff ran out";
+    ASSERT_TRUE(run_until([&]() { return connection.get_health().failures > failures; }));
+    expected = std::min(expected * 2, max_backoff);
+    EXPECT_EQ(connection.get_health().backoff_ms, expected);
+  }
+  EXPECT_EQ(speaker->stats().connections, 1u);
+
+  speaker->set_online(true);
+  ASSERT_TRUE(run_until([&]() { return !connection.is_down(); }, max_backoff + 1));
+  ASSERT_TRUE(run_until([&]() { return connection.is_idle(); }));
+  EXPECT_FLOAT_EQ(speaker->level(), 45.0f);
+  EXPECT_EQ(speaker->stats().writes, 1u);  // The latest level only
+  EXPECT_TRUE(transact(PING));
+}
+
+// Every reply is a sample for the RFC 6298 estimator; each timeout doubles
+// the deadline until the next sample resets it
+TEST_F(SessionTest, TimeoutFollowsTheRoundTripTime) {
+  EmulatorConfig config;
+  config.latency_ms = 60;
+  start(config);
+  const uint32_t min_timeout = SscConnection::MIN_TIMEOUT_MS;
+  const uint32_t max_timeout = SscConnection::MAX_TIMEOUT_MS;
+
+  bool above_minimum = false;
+  for (int i = 0; i < 40; i++) {
+    ASSERT_TRUE(transact(PING));
+    const network::ConnectionHealth &health = connection.get_health();
+    EXPECT_NEAR(health.last_rtt_ms, 60, 1);
+    uint32_t timeout = health.smoothed_rtt_ms + 4 * health.rtt_variance_ms;
+    EXPECT_NEAR(health.timeout_ms, std::min(std::max(timeout, min_timeout), max_timeout), 3);  // Variance in 1/4 ms
+    above_minimum |= health.timeout_ms > min_timeout;
+  }
+  EXPECT_TRUE(above_minimum);  // While the first, instant handshake sample wore off
+  EXPECT_NEAR(connection.get_health().smoothed_rtt_ms, 60, 1);
+  EXPECT_LE(connection.get_health().rtt_variance_ms, 1u);
+  uint32_t expected = connection.get_health().timeout_ms;
+  EXPECT_EQ(expected, min_timeout);
+
+  // Replies held back for a second; tagged sessions survive the timeouts
+  for (int i = 0; i < 3; i++) {
+    EXPECT_FALSE(transact(DELAYED_PING));
+    expected *= 2;
+    EXPECT_EQ(connection.get_health().timeout_ms, expected);
+    EXPECT_TRUE(connection.is_connected());
+  }
+  run_for(1500);  // The late replies are dropped
+  ASSERT_TRUE(transact(PING));
+  EXPECT_EQ(connection.get_health().timeout_ms, min_timeout);
+}
+
+// A reply longer than the receive buffer is skipped up to its newline; the
+// session and the replies behind it are unaffected
+TEST_F(SessionTest, DropsMessagesLongerThanTheBuffer) {
+  start();
+  ASSERT_TRUE(transact(PING));
+  ASSERT_EQ(connection.get_xid_mode(), SscConnection::XidMode::TAGGED);
+
+  // The speaker's 404 names the address it was asked for
+  std::string address(SscConnection::RX_BUFFER_SIZE + 100, 'x');
+  bool long_done = false;
+  bool long_success = true;
+  bool ping_done = false;
+  bool ping_success = false;
+  ASSERT_TRUE(connection.submit("{\"audio\":{\"out\":{\"" + address + "\":null}}}",
+                                [&](bool success, Slice) {
+                                  long_done = true;
+                                  long_success = success;
+                                }));
+  ASSERT_TRUE(connection.submit(PING, [&](bool success, Slice) {
+    ping_done = true;
+    ping_success = success;
+  }));
+  ASSERT_TRUE(run_until([&]() { return long_done && ping_done; }));
+  EXPECT_FALSE(long_success);  // Timed out, its reply never surfaced
+  EXPECT_TRUE(ping_success);
+  EXPECT_EQ(speaker->stats().errors, 1u);
+
+  std::string reply;
+  ASSERT_TRUE(transact("{\"audio\":{\"out\":{\"eq2\":{\"desc\":null}}}}", &reply));
+  EXPECT_NE(reply.find("user EQ"), std::string::npos);
+  EXPECT_TRUE(connection.is_connected());
+  EXPECT_EQ(connection.get_health().connects, 1u);
+}